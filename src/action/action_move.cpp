@@ -159,7 +159,8 @@ int DoActionMove(CUnit &unit)
 				// FIXME: Unit doesn't animate.
 				unit.Frame = unit.Type->StillFrame;
 				UnitUpdateHeading(unit);
-				unit.Wait = 10;
+				// A queued search gives the path at the next cycle.
+				unit.Wait = unit.pathFinderData->output.Queued ? 1 : 10;
 
 				unit.Moving = 0;
 				return d;
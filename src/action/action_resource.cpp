@@ -95,7 +95,7 @@ VisitResult NearReachableTerrainFinder::Visit(TerrainTraversal &terrainTraversal
 		return VisitResult_Finished;
 	}
 	if (Map.CheckMask(pos, resmask)) { // reachable
-		if (terrainTraversal.Get(pos) <= maxDist) {
+		if (maxDist >= 0 && terrainTraversal.Get(pos) <= TerrainTraversal::dataType(maxDist)) {
 			return VisitResult_Ok;
 		} else {
 			return VisitResult_DeadEnd;
@@ -41,6 +41,8 @@
 
 #include "actions.h"
 
+#include "SDL.h"
+
 #include "action/action_attack.h"
 #include "action/action_board.h"
 #include "action/action_build.h"
@@ -362,33 +364,227 @@ static void HandleUnitAction(CUnit &unit)
 	unit.Orders[0]->Execute(unit);
 }
 
-template <typename UNITP_ITERATOR>
-static void UnitActionsEachSecond(UNITP_ITERATOR begin, UNITP_ITERATOR end)
+/**
+**  Handle the things about a unit happening each second.
+**
+**  @param unit  Pointer to handled unit.
+*/
+static void HandleUnitEachSecond(CUnit &unit)
 {
-	for (UNITP_ITERATOR it = begin; it != end; ++it) {
-		CUnit &unit = **it;
+	if (unit.Destroyed) {
+		return;
+	}
 
-		if (unit.Destroyed) {
-			continue;
+	// OnEachSecond callback
+	if (unit.Type->OnEachSecond  && unit.IsUnusable(false) == false) {
+		unit.Type->OnEachSecond->pushPreamble();
+		unit.Type->OnEachSecond->pushInteger(UnitNumber(unit));
+		unit.Type->OnEachSecond->run();
+	}
+
+	// 1) Blink flag.
+	if (unit.Blink) {
+		--unit.Blink;
+	}
+	// 2) Buffs...
+	HandleBuffs(unit, CYCLES_PER_SECOND);
+
+	// 3) Increase health mana, burn and stuff
+	HandleRegenerations(unit);
+}
+
+/**
+**  Check if the things happening each second to a unit can change more
+**  than the unit itself: its callback, its death by time to live or its
+**  burning.
+**
+**  This replays the parts of HandleBuffs and HandleRegenerations which
+**  decide it, without changing the unit.
+**
+**  @param unit  Unit to check.
+*/
+static bool IsUnitEachSecondShared(const CUnit &unit)
+{
+	if (unit.Destroyed) {
+		return false;
+	}
+	if (unit.Type->OnEachSecond && unit.IsUnusable(false) == false) {
+		return true;
+	}
+	const CVariable &hp = unit.Variable[HP_INDEX];
+	int value = hp.Value;
+
+	if (unit.TTL && unit.TTL < GameCycle) {
+		value -= CYCLES_PER_SECOND;
+		if (value <= 0) {
+			return true;
 		}
+	}
+	if (hp.Enable && hp.Increase) {
+		value += hp.Increase;
+		clamp(&value, 0, hp.Max);
+	}
+	if (unit.Removed || !hp.Max
+		|| unit.CurrentAction() == UnitActionBuilt || unit.CurrentAction() == UnitActionDie) {
+		return false;
+	}
+	return (100 * value) / hp.Max <= unit.Type->BurnPercent && unit.Type->BurnDamageRate;
+}
+
+/**
+**  Handle the things happening each second to a run of units.
+*/
+static void HandleUnitsEachSecond(CUnit *const *begin, CUnit *const *end)
+{
+	for (CUnit *const *it = begin; it != end; ++it) {
+		HandleUnitEachSecond(**it);
+	}
+}
 
-		// OnEachSecond callback
-		if (unit.Type->OnEachSecond  && unit.IsUnusable(false) == false) {
-			unit.Type->OnEachSecond->pushPreamble();
-			unit.Type->OnEachSecond->pushInteger(UnitNumber(unit));
-			unit.Type->OnEachSecond->run();
+/// Thread helping the game loop with the units each second
+struct EachSecondWorker {
+	SDL_Thread *Thread;   /// the thread
+	SDL_sem *Start;       /// posted when the units are to be handled
+	CUnit *const *Begin;  /// first unit to handle
+	CUnit *const *End;    /// end of the units to handle
+};
+
+/// Most threads helping the game loop with the units each second
+static const int EachSecondWorkerMax = 3;
+/// Runs of units shorter than this are not shared out
+static const size_t EachSecondParallelMin = 256;
+
+static EachSecondWorker EachSecondWorkers[EachSecondWorkerMax];
+static int EachSecondWorkerCount = -1;  /// threads started, -1 before the first try
+static SDL_sem *EachSecondDone;         /// posted by a thread when its units are handled
+static bool EachSecondWorkersQuit;      /// threads must end when started again
+
+static int EachSecondWorkerLoop(void *data)
+{
+	EachSecondWorker &worker = *static_cast<EachSecondWorker *>(data);
+
+	for (;;) {
+		SDL_SemWait(worker.Start);
+		if (EachSecondWorkersQuit) {
+			break;
 		}
+		HandleUnitsEachSecond(worker.Begin, worker.End);
+		SDL_SemPost(EachSecondDone);
+	}
+	return 0;
+}
 
-		// 1) Blink flag.
-		if (unit.Blink) {
-			--unit.Blink;
+/**
+**  Start the threads helping with the units each second, once.
+**
+**  @return  Number of threads running.
+*/
+static int StartEachSecondWorkers()
+{
+	if (EachSecondWorkerCount != -1) {
+		return EachSecondWorkerCount;
+	}
+	EachSecondWorkerCount = 0;
+	EachSecondWorkersQuit = false;
+	EachSecondDone = SDL_CreateSemaphore(0);
+	if (EachSecondDone == NULL) {
+		return 0;
+	}
+	for (int i = 0; i != EachSecondWorkerMax; ++i) {
+		EachSecondWorker &worker = EachSecondWorkers[i];
+
+		worker.Start = SDL_CreateSemaphore(0);
+		if (worker.Start == NULL) {
+			break;
+		}
+		worker.Thread = SDL_CreateThread(EachSecondWorkerLoop, &worker);
+		if (worker.Thread == NULL) {
+			SDL_DestroySemaphore(worker.Start);
+			break;
 		}
-		// 2) Buffs...
-		HandleBuffs(unit, CYCLES_PER_SECOND);
+		++EachSecondWorkerCount;
+	}
+	return EachSecondWorkerCount;
+}
+
+/**
+**  Stop the threads helping with the units each second.
+**
+**  They are started again by the next game which needs them.
+*/
+void StopEachSecondWorkers()
+{
+	if (EachSecondWorkerCount == -1) {
+		return;
+	}
+	EachSecondWorkersQuit = true;
+	for (int i = 0; i != EachSecondWorkerCount; ++i) {
+		SDL_SemPost(EachSecondWorkers[i].Start);
+	}
+	for (int i = 0; i != EachSecondWorkerCount; ++i) {
+		SDL_WaitThread(EachSecondWorkers[i].Thread, NULL);
+		SDL_DestroySemaphore(EachSecondWorkers[i].Start);
+	}
+	if (EachSecondDone) {
+		SDL_DestroySemaphore(EachSecondDone);
+		EachSecondDone = NULL;
+	}
+	EachSecondWorkerCount = -1;
+}
+
+/**
+**  Handle the things happening each second to a run of units which only
+**  change themselves, shared between the game loop and its threads.
+*/
+static void HandleUnitsEachSecondInParallel(CUnit *const *begin, CUnit *const *end)
+{
+	const size_t count = end - begin;
+
+	if (count < EachSecondParallelMin || StartEachSecondWorkers() == 0) {
+		HandleUnitsEachSecond(begin, end);
+		return;
+	}
+	const int slices = EachSecondWorkerCount + 1;
+
+	for (int i = 0; i != EachSecondWorkerCount; ++i) {
+		EachSecondWorker &worker = EachSecondWorkers[i];
 
-		// 3) Increase health mana, burn and stuff
-		HandleRegenerations(unit);
+		worker.Begin = begin + count * (i + 1) / slices;
+		worker.End = begin + count * (i + 2) / slices;
+		SDL_SemPost(worker.Start);
 	}
+	HandleUnitsEachSecond(begin, begin + count / slices);
+	for (int i = 0; i != EachSecondWorkerCount; ++i) {
+		SDL_SemWait(EachSecondDone);
+	}
+}
+
+/**
+**  Handle the things happening each second to all the units.
+**
+**  The units whose handling can change the game are handled in order,
+**  as before. The runs of units between them only change themselves, so
+**  they are handled in parallel with the same result.
+**
+**  @param table  Units, in the order of the unit manager.
+*/
+static void UnitActionsEachSecond(const std::vector<CUnit *> &table)
+{
+	if (table.empty()) {
+		return;
+	}
+	CUnit *const *end = &table[0] + table.size();
+	CUnit *const *run = &table[0];
+
+	for (CUnit *const *it = run; it != end; ++it) {
+		// Earlier units of the run can't change it, later ones wait for it.
+		if (IsUnitEachSecondShared(**it)) {
+			HandleUnitsEachSecondInParallel(run, it);
+			HandleUnitEachSecond(**it);
+			run = it + 1;
+		}
+	}
+	HandleUnitsEachSecondInParallel(run, end);
 }
 
 #ifdef DEBUG_LOG
@@ -428,6 +624,58 @@ static void DumpUnitInfo(CUnit &unit)
 
 #endif // DEBUG_LOG
 
+/**
+**  Check if the orders of an action only count down the Wait of the unit,
+**  while it is not 0, without any animation.
+**
+**  @param action  Action of the current order of the unit.
+*/
+static bool IsWaitingAction(int action)
+{
+	switch (action) {
+		case UnitActionFollow:
+		case UnitActionMove:
+		case UnitActionAttack:
+		case UnitActionAttackGround:
+		case UnitActionSpellCast:
+		case UnitActionPatrol:
+		case UnitActionBuild:
+		case UnitActionResource:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+**  Park a unit if its next cycles only count down its Wait.
+**
+**  A parked unit doesn't read its orders or type until Wait reaches 0
+**  or WakeUpUnit is called when its orders change.
+**
+**  @param unit  Unit whose action was just handled.
+*/
+static void ParkUnit(CUnit &unit)
+{
+	if (unit.Wait == 0 || unit.Destroyed || unit.Type->OnEachCycle || unit.CriticalOrder) {
+		return;
+	}
+	const COrder &order = *unit.CurrentOrder();
+
+	if (!order.Finished && IsWaitingAction(order.Action)) {
+		unit.ParkedAction = order.Action;
+	}
+}
+
+/**
+**  Let a unit parked in UnitActions run its orders again.
+**
+**  @param unit  Unit whose orders are changed.
+*/
+void WakeUpUnit(CUnit &unit)
+{
+	unit.ParkedAction = UnitActionNone;
+}
 
 template <typename UNITP_ITERATOR>
 static void UnitActionsEachCycle(UNITP_ITERATOR begin, UNITP_ITERATOR end)
@@ -439,6 +687,21 @@ static void UnitActionsEachCycle(UNITP_ITERATOR begin, UNITP_ITERATOR end)
 			continue;
 		}
 
+		// Parked unit: its action would only count down Wait.
+		if (unit.ParkedAction != UnitActionNone) {
+			if (unit.Wait) {
+				unit.Wait--;
+#ifdef DEBUG_LOG
+				DumpUnitInfo(unit);
+#endif
+				SyncHash = (SyncHash << 5) | (SyncHash >> 27);
+				SyncHash ^= unit.ParkedAction << 18;
+				SyncHash ^= unit.Refs << 3;
+				continue;
+			}
+			WakeUpUnit(unit);
+		}
+
 		// OnEachCycle callback
 		if (unit.Type->OnEachCycle && unit.IsUnusable(false) == false) {
 			unit.Type->OnEachCycle->pushPreamble();
@@ -448,6 +711,7 @@ static void UnitActionsEachCycle(UNITP_ITERATOR begin, UNITP_ITERATOR end)
 
 		try {
 			HandleUnitAction(unit);
+			ParkUnit(unit);
 		} catch (AnimationDie_Exception &) {
 			AnimationDie_OnCatch(unit);
 		}
@@ -469,14 +733,17 @@ void UnitActions()
 {
 	const bool isASecondCycle = !(GameCycle % CYCLES_PER_SECOND);
 	// Unit list may be modified during loop... so make a copy
-	std::vector<CUnit *> table(UnitManager.begin(), UnitManager.end());
+	static std::vector<CUnit *> table;
+	table.assign(UnitManager.begin(), UnitManager.end());
 
 	// Check for things that only happen every second
 	if (isASecondCycle) {
-		UnitActionsEachSecond(table.begin(), table.end());
+		UnitActionsEachSecond(table);
 	}
 	// Do all actions
 	UnitActionsEachCycle(table.begin(), table.end());
+	// Paths searched by the units, they follow them from the next cycle
+	SolvePathRequests();
 }
 
 //@}
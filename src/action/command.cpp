@@ -63,6 +63,7 @@ static void ReleaseOrders(CUnit &unit)
 {
 	Assert(unit.Orders.empty() == false);
 
+	WakeUpUnit(unit);
 	// Order 0 must be stopped in the action loop.
 	for (size_t i = 1; i != unit.Orders.size(); ++i) {
 		delete unit.Orders[i];
@@ -91,6 +92,7 @@ static COrderPtr *GetNextOrder(CUnit &unit, int flush)
 	if (unit.Orders.size() == maxOrderCount) {
 		return NULL;
 	}
+	WakeUpUnit(unit);
 	unit.Orders.push_back(NULL);
 	return &unit.Orders.back();
 }
@@ -105,6 +107,7 @@ static void RemoveOrder(CUnit &unit, unsigned int order)
 {
 	Assert(order < unit.Orders.size());
 
+	WakeUpUnit(unit);
 	delete unit.Orders[order];
 	unit.Orders.erase(unit.Orders.begin() + order);
 	if (unit.Orders.empty()) {
@@ -691,6 +694,7 @@ void CommandTransformIntoType(CUnit &unit, CUnitType &type)
 {
 	Assert(unit.CriticalOrder == NULL);
 
+	WakeUpUnit(unit);
 	unit.CriticalOrder = COrder::NewActionTransformInto(type);
 }
 
@@ -849,21 +853,37 @@ void CommandSharedVision(int player, bool state, int opponent)
 	}
 	const int after = Players[player].IsBothSharedVision(Players[opponent]);
 
-	if (before && !after) {
+	if (before != after) {
+		Map.InitEffectiveVisible();
+	}
+
+	if (before && !after && Map.HasPlayerCounters(player) && Map.HasPlayerCounters(opponent)) {
 		// Don't share vision anymore. Give each other explored terrain for good-bye.
 		Vec2i pos;
 		for (pos.x = 0; pos.x < Map.Info.MapWidth; ++pos.x) {
 			for (pos.y = 0; pos.y < Map.Info.MapHeight; ++pos.y) {
-				CMapField &mf = *Map.Field(pos);
-
-				if (mf.Visible[player] && !mf.Visible[opponent]) {
-					mf.Visible[opponent] = 1;
+				const unsigned int index = Map.getIndex(pos);
+				unsigned short &playerVisible = Map.Visible[player][index];
+				unsigned short &opponentVisible = Map.Visible[opponent][index];
+
+				if (playerVisible && !opponentVisible) {
+					opponentVisible = 1;
+					Map.UpdateEffectiveVisible(Players[opponent], index);
+					// Without fog of war, units on explored fields are seen.
+					if (Map.NoFogOfWar) {
+						UnitsOnTileMarkSeen(Players[opponent], index, 0);
+					}
 					if (opponent == ThisPlayer->Index) {
 						Map.MarkSeenTile(pos);
 					}
 				}
-				if (mf.Visible[opponent] && !mf.Visible[player]) {
-					mf.Visible[player] = 1;
+				if (opponentVisible && !playerVisible) {
+					playerVisible = 1;
+					Map.UpdateEffectiveVisible(Players[player], index);
+					// Without fog of war, units on explored fields are seen.
+					if (Map.NoFogOfWar) {
+						UnitsOnTileMarkSeen(Players[player], index, 0);
+					}
 					if (player == ThisPlayer->Index) {
 						Map.MarkSeenTile(pos);
 					}
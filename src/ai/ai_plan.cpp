@@ -144,7 +144,7 @@ VisitResult WallFinder::Visit(TerrainTraversal &terrainTraversal, const Vec2i &p
 		return VisitResult_Finished;
 	}
 	if (Map.CheckMask(pos, movemask)) { // reachable
-		if (terrainTraversal.Get(pos) <= maxDist) {
+		if (maxDist >= 0 && terrainTraversal.Get(pos) <= TerrainTraversal::dataType(maxDist)) {
 			return VisitResult_Ok;
 		} else {
 			return VisitResult_DeadEnd;
@@ -208,49 +208,14 @@ int AiFindWall(AiForce *force)
 }
 
 
-class ReachableTerrainMarker
-{
-public:
-	ReachableTerrainMarker(const CUnit &unit) :
-		unit(unit),
-		movemask(unit.Type->MovementMask & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit))
-	{}
-	VisitResult Visit(TerrainTraversal &terrainTraversal, const Vec2i &pos, const Vec2i &from);
-private:
-	const CUnit &unit;
-	int movemask;
-};
-
-VisitResult ReachableTerrainMarker::Visit(TerrainTraversal &terrainTraversal, const Vec2i &pos, const Vec2i &from)
-{
-#if 0
-	if (!player.AiEnabled && !Map.IsFieldExplored(player, pos)) {
-		return VisitResult_DeadEnd;
-	}
-#endif
-	if (CanMoveToMask(pos, movemask)) { // reachable
-		return VisitResult_Ok;
-	} else { // unreachable
-		return VisitResult_DeadEnd;
-	}
-}
-
-static void MarkReacheableTerrainType(const CUnit &unit, TerrainTraversal *terrainTraversal)
-{
-	terrainTraversal->PushUnitPosAndNeighboor(unit);
-
-	ReachableTerrainMarker reachableTerrainMarker(unit);
-
-	terrainTraversal->Run(reachableTerrainMarker);
-}
-
 class EnemyFinderWithTransporter
 {
 public:
-	EnemyFinderWithTransporter(const CUnit &unit, const TerrainTraversal &terrainTransporter, Vec2i *resultPos) :
+	EnemyFinderWithTransporter(const CUnit &unit, const CUnit &transporter, Vec2i *resultPos) :
 		unit(unit),
-		terrainTransporter(terrainTransporter),
 		movemask(unit.Type->MovementMask & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)),
+		transporterMask(transporter.Type->MovementMask & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)),
+		transporterRegion(GetMapRegion(transporterMask, Map.getIndex(transporter.tilePos))),
 		resultPos(resultPos)
 	{}
 	VisitResult Visit(TerrainTraversal &terrainTraversal, const Vec2i &pos, const Vec2i &from);
@@ -258,14 +223,18 @@ private:
 	bool IsAccessibleForTransporter(const Vec2i &pos) const;
 private:
 	const CUnit &unit;
-	const TerrainTraversal &terrainTransporter;
 	int movemask;
+	int transporterMask;
+	int transporterRegion;
 	Vec2i *resultPos;
 };
 
 bool EnemyFinderWithTransporter::IsAccessibleForTransporter(const Vec2i &pos) const
 {
-	return terrainTransporter.IsReached(pos);
+	if (transporterMask == 0) { // Nothing static stops a flying transporter.
+		return true;
+	}
+	return transporterRegion != 0 && GetMapRegion(transporterMask, Map.getIndex(pos)) == transporterRegion;
 }
 
 VisitResult EnemyFinderWithTransporter::Visit(TerrainTraversal &terrainTraversal, const Vec2i &pos, const Vec2i &from)
@@ -287,7 +256,7 @@ VisitResult EnemyFinderWithTransporter::Visit(TerrainTraversal &terrainTraversal
 	}
 }
 
-static bool AiFindTarget(const CUnit &unit, const TerrainTraversal &terrainTransporter, Vec2i *resultPos)
+static bool AiFindTarget(const CUnit &unit, const CUnit &transporter, Vec2i *resultPos)
 {
 	TerrainTraversal terrainTraversal;
 
@@ -296,7 +265,7 @@ static bool AiFindTarget(const CUnit &unit, const TerrainTraversal &terrainTrans
 
 	terrainTraversal.PushUnitPosAndNeighboor(unit);
 
-	EnemyFinderWithTransporter enemyFinderWithTransporter(unit, terrainTransporter, resultPos);
+	EnemyFinderWithTransporter enemyFinderWithTransporter(unit, transporter, resultPos);
 
 	return terrainTraversal.Run(enemyFinderWithTransporter);
 }
@@ -342,21 +311,14 @@ int AiForce::PlanAttack()
 	DebugPrint("%d: Planning for force #%lu of player #%d\n"_C_ player.Index
 			   _C_(long unsigned int)(this - & (AiPlayer->Force[0])) _C_ player.Index);
 
-	TerrainTraversal transporterTerrainTraversal;
-
-	transporterTerrainTraversal.SetSize(Map.Info.MapWidth, Map.Info.MapHeight);
-	transporterTerrainTraversal.Init();
-
 	CUnit *transporter = Units.find(IsAFreeTransporter());
 
 	if (transporter != NULL) {
 		DebugPrint("%d: Transporter #%d\n" _C_ player.Index _C_ UnitNumber(*transporter));
-		MarkReacheableTerrainType(*transporter, &transporterTerrainTraversal);
 	} else {
 		std::vector<CUnit *>::iterator it = std::find_if(player.UnitBegin(), player.UnitEnd(), IsAFreeTransporter());
 		if (it != player.UnitEnd()) {
 			transporter = *it;
-			MarkReacheableTerrainType(*transporter, &transporterTerrainTraversal);
 		} else {
 			DebugPrint("%d: No transporter available\n" _C_ player.Index);
 			return 0;
@@ -373,7 +335,7 @@ int AiForce::PlanAttack()
 
 	Vec2i pos = this->GoalPos;
 
-	if (AiFindTarget(*landUnit, transporterTerrainTraversal, &pos)) {
+	if (AiFindTarget(*landUnit, *transporter, &pos)) {
 		const int forceIndex = AiPlayer->Force.getIndex(this) + 1;
 
 		if (transporter->GroupId != forceIndex) {
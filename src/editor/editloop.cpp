@@ -1929,7 +1929,7 @@ void CEditor::Init()
 			}
 		}
 
-		Map.Fields = new CMapField[Map.Info.MapWidth * Map.Info.MapHeight];
+		Map.Create();
 
 		// Hard coded
 		const int defaultTile = 0x50;
@@ -394,6 +394,7 @@ void ChangeTile(const Vec2i &pos, int tile)
 
 	CMapField *mf = Map.Field(pos);
 	mf->Tile = mf->SeenTile = Map.Tileset.Table[tile];
+	MapBackgroundTileChanged(Map.getIndex(pos));
 }
 
 #define DIR_UP     8 /// Go up allowed
@@ -951,6 +951,7 @@ void CleanGame()
 	CleanAi();
 	CleanGroups();
 	CleanMissiles();
+	StopEachSecondWorkers();
 	CleanUnits();
 	CleanSelections();
 	CleanTilesets();
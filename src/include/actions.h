@@ -189,6 +189,10 @@ extern void CclParseOrder(lua_State *l, CUnit &unit, COrderPtr *order);
 
 /// Handle the actions of all units each game cycle
 extern void UnitActions();
+/// Let a unit parked in UnitActions run its orders again
+extern void WakeUpUnit(CUnit &unit);
+/// Stop the threads helping the unit actions
+extern void StopEachSecondWorkers();
 
 //@}
 
@@ -52,6 +52,45 @@
 **    An array CMap::Info::Width * CMap::Info::Height of all fields
 **    belonging to this map.
 **
+**  CMap::Visible[]
+**
+**    For each player, the counter of each field of how many units of
+**    the player can see this field. 0 the field is not explored, 1
+**    explored, n-1 units see it. Currently no more than 253 units can
+**    see a field. The counters of a player are contiguous, so scans of
+**    CMap::Fields don't load them.
+**
+**  CMap::EffectiveVisible[]
+**
+**    For each player, the vision of each field with the fields seen by
+**    the players sharing vision with him: 0 unexplored, 1 explored, 2
+**    visible. Updated when a field changes between these states and
+**    rebuilt when the shared vision changes.
+**
+**  CMap::VisCloak[]
+**
+**    For each player, the visibility of each field for cloaking.
+**
+**  CMap::Radar[]
+**
+**    For each player, the visibility of each field for radar.
+**
+**  CMap::RadarJammer[]
+**
+**    For each player, the jamming capabilities of each field.
+**
+**  CMap::PlayerCounters
+**
+**    The block holding the planes above. Only the players in use when
+**    the map is created have their own planes, the others share one
+**    plane of zeros for each kind of counter and must never write it.
+**
+**  CMap::RadarPlayers CMap::RadarJammerPlayers
+**
+**    For each field, a bit for each player whose radar, or jammer,
+**    counter is not 0. A radar test of a unit is a few masks over its
+**    fields instead of a counter for each player.
+**
 **  CMap::NoFogOfWar
 **
 **    Flag if true, the fog of war is disabled.
@@ -108,8 +147,8 @@ class CUnitType;
 --  Map
 ----------------------------------------------------------------------------*/
 
-#define MaxMapWidth  256  /// max map width supported
-#define MaxMapHeight 256  /// max map height supported
+#define MaxMapWidth  1024  /// max map width supported
+#define MaxMapHeight 1024  /// max map height supported
 
 // Not used until now:
 #define MapFieldSpeedMask 0x0007  /// Move faster on this tile
@@ -180,6 +219,12 @@ public:
 
 	/// Alocate and initialise map table.
 	void Create();
+	/// Free the map table.
+	void FreeFields();
+	/// Rebuild the effective vision of all players
+	void InitEffectiveVisible();
+	/// Vision of a field by a player has changed
+	void UpdateEffectiveVisible(const CPlayer &player, const unsigned int index);
 	/// Build tables for map
 	void Init();
 	/// Clean the map
@@ -216,6 +261,11 @@ public:
 		return CheckMask(getIndex(pos), mask);
 	}
 
+	/// Check if a player has its own counters, else they are always 0.
+	bool HasPlayerCounters(int player) const {
+		return this->Visible[player] != reinterpret_cast<unsigned short *>(this->PlayerCounters);
+	}
+
 	/// Check if a field for the user is explored.
 	bool IsFieldExplored(const CPlayer &player, const unsigned int index) const;
 
@@ -250,6 +300,12 @@ public:
 
 	/// Regenerate the forest.
 	void RegenerateForest();
+	/// Schedule the regeneration of all the cleared forest
+	void InitForestRegeneration();
+	/// Schedule the regeneration of a field, if it is cleared forest
+	void ScheduleForestRegeneration(const unsigned int index);
+	/// Value of a field, with the regeneration of cleared forest
+	unsigned char GetFieldValue(const unsigned int index) const;
 	/// Reveal the complete map, make everything known.
 	void Reveal();
 	/// Save the map.
@@ -387,11 +443,19 @@ private:
 	void FixTile(unsigned short type, int seen, const Vec2i &pos);
 
 	/// Regenerate the forest.
-	void RegenerateForestTile(const Vec2i &pos);
+	bool RegenerateForestTile(const Vec2i &pos);
 
 
 public:
 	CMapField *Fields;              /// fields on map
+	unsigned short *Visible[PlayerMax];    /// Seen counters of the fields for each player, 0 unexplored
+	unsigned char *EffectiveVisible[PlayerMax]; /// Vision of the fields for each player with shared vision
+	unsigned char *VisCloak[PlayerMax];    /// Visiblity for cloaking of the fields for each player
+	unsigned char *Radar[PlayerMax];       /// Visiblity for radar of the fields for each player
+	unsigned char *RadarJammer[PlayerMax]; /// Jamming capabilities of the fields for each player
+	unsigned char *PlayerCounters;    /// Block of the counters above, shared planes first
+	unsigned int *RadarPlayers;       /// Players with radar on each field, bit for each player
+	unsigned int *RadarJammerPlayers; /// Players jamming each field, bit for each player
 
 	bool NoFogOfWar;           /// fog of war disabled
 
@@ -411,6 +475,12 @@ public:
 extern CMap Map;  /// The current map
 extern char CurrentMapPath[1024]; /// Path to the current map
 
+/// Check if a field for the user is explored.
+inline bool CMapField::IsExplored(const unsigned int player_index) const
+{
+	return Map.Visible[player_index][this - Map.Fields] != 0;
+}
+
 /// Contrast of fog of war
 extern int FogOfWarOpacity;
 /// RGB triplet (0-255) of fog of war color
@@ -435,6 +505,8 @@ typedef void MapMarkerFunc(const CPlayer &player, const Vec2i &pos);
 #else
 typedef void MapMarkerFunc(const CPlayer &player, const unsigned int index);
 #endif
+/// Function to (un)mark the tiles [index, end) of a row.
+typedef void MapSpanMarkerFunc(const CPlayer &player, unsigned int index, unsigned int end);
 
 /// Filter map flags through fog
 extern int MapFogFilterFlags(CPlayer &player, const Vec2i &pos, int mask);
@@ -451,8 +523,19 @@ extern MapMarkerFunc MapUnmarkTileDetectCloak;
 /// Mark sight changes
 extern void MapSight(const CPlayer &player, const Vec2i &pos, int w,
 					 int h, int range, MapMarkerFunc *marker);
+extern void MapSight(const CPlayer &player, const Vec2i &pos, int w,
+					 int h, int range, MapSpanMarkerFunc *marker);
+/// Mark sight changes of a moved unit, only the tiles not seen from before
+extern void MapSightDelta(const CPlayer &player, const Vec2i &from, const Vec2i &to,
+						  int w, int h, int range, MapMarkerFunc *marker);
+extern void MapSightDelta(const CPlayer &player, const Vec2i &from, const Vec2i &to,
+						  int w, int h, int range, MapSpanMarkerFunc *marker);
 /// Update fog of war
 extern void UpdateFogOfWarChange();
+/// The fog of war of a tile has changed, draw it again
+extern void FogOfWarTileChanged(unsigned int index);
+/// The fog of war of the whole map has changed, draw it again
+extern void FogOfWarChanged();
 
 //
 // in map_radar.c
@@ -470,6 +553,15 @@ extern MapMarkerFunc MapMarkTileRadarJammer;
 /// Unmark a tile as jammed, decrease is jamming'ness
 extern MapMarkerFunc MapUnmarkTileRadarJammer;
 
+/// Mark a span of tiles as radar visible
+extern MapSpanMarkerFunc MapMarkRadarSpan;
+/// Unmark a span of tiles as radar visible
+extern MapSpanMarkerFunc MapUnmarkRadarSpan;
+/// Mark a span of tiles as radar jammed
+extern MapSpanMarkerFunc MapMarkRadarJammerSpan;
+/// Unmark a span of tiles as radar jammed
+extern MapSpanMarkerFunc MapUnmarkRadarJammerSpan;
+
 
 //
 // in map_wall.c
@@ -481,6 +573,14 @@ extern void MapFixSeenWallNeighbors(const Vec2i &pos);
 /// Correct the real wall field, depending on the surrounding
 extern void MapFixWallTile(const Vec2i &pos);
 
+//
+// in map_draw.c
+//
+/// The tile drawn on a field has changed
+extern void MapBackgroundTileChanged(unsigned int index);
+/// Free the drawn chunks of the map background
+extern void FreeMapBackground();
+
 //
 // in script_map.c
 //
@@ -536,20 +636,20 @@ inline bool CanMoveToMask(const Vec2i &pos, int mask)
 /// Handle Marking and Unmarking of radar vision
 inline void MapMarkRadar(const CPlayer &player, const Vec2i &pos, int w, int h, int range)
 {
-	MapSight(player, pos, w, h, range, MapMarkTileRadar);
+	MapSight(player, pos, w, h, range, MapMarkRadarSpan);
 }
 inline void MapUnmarkRadar(const CPlayer &player, const Vec2i &pos, int w, int h, int range)
 {
-	MapSight(player, pos, w, h, range, MapUnmarkTileRadar);
+	MapSight(player, pos, w, h, range, MapUnmarkRadarSpan);
 }
 /// Handle Marking and Unmarking of radar vision
 inline void MapMarkRadarJammer(const CPlayer &player, const Vec2i &pos, int w, int h, int range)
 {
-	MapSight(player, pos, w, h, range, MapMarkTileRadarJammer);
+	MapSight(player, pos, w, h, range, MapMarkRadarJammerSpan);
 }
 inline void MapUnmarkRadarJammer(const CPlayer &player, const Vec2i &pos, int w, int h, int range)
 {
-	MapSight(player, pos, w, h, range, MapUnmarkTileRadarJammer);
+	MapSight(player, pos, w, h, range, MapUnmarkRadarJammerSpan);
 }
 
 //@}
@@ -58,7 +58,8 @@ public:
 		Transparent(false), UpdateCache(false) {}
 
 	void UpdateXY(const Vec2i &pos);
-	void UpdateSeenXY(const Vec2i &) {}
+	void UpdateSeenXY(const Vec2i &pos);
+	void Invalidate();
 	void Update();
 	void Create();
 	void FreeOpenGL();
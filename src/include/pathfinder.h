@@ -40,6 +40,9 @@
 #endif
 #endif
 
+/// Clearances of the map tiles are not computed above
+#define MAX_MAP_CLEARANCE 8
+
 #if defined(DEBUG_ASTAR)
 #define AstarDebugPrint(x) DebugPrint(x)
 #else
@@ -107,8 +110,6 @@ private:
 
 class PathFinderOutput
 {
-public:
-	enum {MAX_PATH_LENGTH = 28}; /// max length of precalculated path
 public:
 	PathFinderOutput();
 	void Save(CFile &file) const;
@@ -116,8 +117,11 @@ public:
 public:
 	unsigned short int Cycles;  /// how much Cycles we move.
 	char Fast;                  /// Flag fast move (one step)
-	char Length;                /// stored path length
-	char Path[MAX_PATH_LENGTH]; /// directions of stored path
+	int Length;                 /// stored path length
+	std::vector<char> Path;     /// directions of stored path, next one at Length - 1
+	unsigned int MapChanges;    /// map changes when the path was last checked, see GetPathfinderMapChanges
+	bool Queued;                /// a search waits in the queue, see SolvePathRequests
+	bool Solved;                /// result of the queued search in Length, not used yet
 };
 
 class PathFinderData
@@ -142,7 +146,9 @@ enum VisitResult {
 class TerrainTraversal
 {
 public:
-	typedef short unsigned int dataType;
+	// Steps from the start, 0 when not visited, Blocked for a dead end or out of the map.
+	typedef unsigned int dataType;
+	static const dataType Blocked = static_cast<dataType>(-1);
 public:
 	void SetSize(unsigned int width, unsigned int height);
 	void Init();
@@ -185,7 +191,7 @@ bool TerrainTraversal::Run(T &context)
 
 		switch (context.Visit(*this, posNode.pos, posNode.from)) {
 			case VisitResult_Finished: return true;
-			case VisitResult_DeadEnd: Set(posNode.pos, -1); break;
+			case VisitResult_DeadEnd: Set(posNode.pos, Blocked); break;
 			case VisitResult_Ok: PushNeighboor(posNode.pos); break;
 			case VisitResult_Cancel: return false;
 		}
@@ -231,11 +237,67 @@ extern int UnitReachable(const CUnit &unit, const CUnit &dst, int range);
 /// Can the unit 'src' reach the place x,y
 extern int PlaceReachable(const CUnit &src, const Vec2i &pos, int w, int h,
 						  int minrange, int maxrange);
+/// Solve the searches queued by the units and give them their paths
+extern void SolvePathRequests();
+/// Static passability of the tiles has changed
+extern void PathfinderTilesChanged(const Vec2i &pos, int w, int h);
+/// Count of the static changes of the map since InitPathfinder
+extern unsigned int GetPathfinderMapChanges();
+
+//
+// in region.cpp
+//
+
+/// Get the connected region of a tile for a movement mask, 0 if none
+extern int GetMapRegion(int movemask, unsigned int index);
+
+//
+// in clearance.cpp
+//
+
+/// Get the clearance of each tile for a movement mask, NULL if none
+extern const unsigned char *GetMapClearances(int movemask);
+
+//
+// in pathcache.cpp
+//
+
+/// Counters of the path cache
+struct PathCacheCounters {
+	unsigned long Hits;    /// Paths copied from the cache
+	unsigned long Misses;  /// Paths not in the cache
+};
+
+/// A player has explored a tile
+extern void PathCacheTerrainExplored(int player);
+/// Get the counters of the path cache
+extern const PathCacheCounters &GetPathCacheCounters();
 
 //
 // in astar.cpp
 //
 
+/// Counters of the A* searches of a context
+struct AStarCounters {
+	unsigned long Searches;           /// Searches done
+	unsigned long FullClearsAvoided;  /// Searches which used to clear the whole matrix
+	unsigned long FullClears;         /// Whole matrix clears, at generation wrap around
+};
+
+/// State of an A* search, one for each thread searching paths
+class PathfinderContext;
+
+/// Make a context for searches out of the game loop
+extern PathfinderContext *NewPathfinderContext();
+/// Free a context made by NewPathfinderContext
+extern void DeletePathfinderContext(PathfinderContext *context);
+/// Find a path with the given context
+extern int AStarFindPath(PathfinderContext &context, const Vec2i &startPos, const Vec2i &goalPos,
+						 int gw, int gh, int tilesizex, int tilesizey, int minrange, int maxrange,
+						 char *path, int pathlen, const CUnit &unit);
+/// Get the counters of the searches of the game loop
+extern const AStarCounters &GetAStarCounters();
+
 extern void SetAStarFixedUnitCrossingCost(int cost);
 extern int GetAStarFixedUnitCrossingCost();
 
@@ -97,24 +97,6 @@
 **    walls, contains the remaining hit points of the wall and
 **    for forest, contains the frames until they grow.
 **
-**  CMapField::Visible[]
-**
-**    Counter how many units of the player can see this field. 0 the
-**    field is not explored, 1 explored, n-1 unit see it. Currently
-**    no more than 253 units can see a field.
-**
-**  CMapField::VisCloak[]
-**
-**    Visiblity for cloaking.
-**
-**  CMapField::Radar[]
-**
-**    Visiblity for radar.
-**
-**  CMapField::RadarJammer[]
-**
-**    Jamming capabilities.
-**
 **  CMapField::UnitCache
 **
 **    Contains a vector of all units currently on this field.
@@ -150,12 +132,7 @@ public:
 #ifdef DEBUG
 		, TilesetTile(0)
 #endif
-	{
-		memset(Visible, 0, sizeof(Visible));
-		memset(VisCloak, 0, sizeof(VisCloak));
-		memset(Radar, 0, sizeof(Radar));
-		memset(RadarJammer, 0, sizeof(RadarJammer));
-	}
+	{}
 
 	unsigned short Tile;      /// graphic tile number
 	unsigned short SeenTile;  /// last seen tile (FOW)
@@ -164,19 +141,13 @@ public:
 	// FIXME: Value can be removed, walls and regeneration can be handled
 	//        different.
 	unsigned char Value;                  /// HP for walls/ Wood Regeneration
-	unsigned short Visible[PlayerMax];    /// Seen counter 0 unexplored
-	unsigned char VisCloak[PlayerMax];    /// Visiblity for cloaking.
-	unsigned char Radar[PlayerMax];       /// Visiblity for radar.
-	unsigned char RadarJammer[PlayerMax]; /// Jamming capabilities.
 	CUnitCache		UnitCache;			/// A unit on the map field.
 #ifdef DEBUG
 	unsigned int TilesetTile;      /// tileset tile number
 #endif
 
 	/// Check if a field for the user is explored.
-	bool IsExplored(const unsigned int player_index) const {
-		return !!Visible[player_index];
-	};
+	inline bool IsExplored(const unsigned int player_index) const;
 
 };
 
@@ -290,31 +290,13 @@ public:
 		CUnitManagerData() : slot(-1), unitSlot(-1) {}
 
 		int GetUnitId() const { return slot; }
+		int GetUnitIndex() const { return unitSlot; }
 	private:
 		int slot;           /// index in UnitManager::unitSlots
 		int unitSlot;       /// index in UnitManager::units
 	};
 public:
-	// @note int is faster than shorts
-	unsigned int     Refs;         /// Reference counter
-	unsigned int     ReleaseCycle; /// When this unit could be recycled
-	CUnitManagerData UnitManagerData;
-	size_t PlayerSlot;  /// index in Player->Units
-
-	int    InsideCount;   /// Number of units inside.
-	int    BoardCount;    /// Number of units transported inside.
-	CUnit *UnitInside;    /// Pointer to one of the units inside.
-	CUnit *Container;     /// Pointer to the unit containing it (or 0)
-	CUnit *NextContained; /// Next unit in the container.
-	CUnit *PrevContained; /// Previous unit in the container.
-
-	CUnit *NextWorker; //pointer to next assigned worker to "Goal" resource.
-	struct {
-		CUnit *Workers; /// pointer to first assigned worker to this resource.
-		int Assigned; /// how many units are assigned to harvesting from the resource.
-		int Active; /// how many units are harvesting from the resource.
-	} Resource; /// Resource still
-
+	/* Used each cycle by the loops over all the units, kept together. */
 	Vec2i tilePos; /// Map position X
 
 	unsigned int Offset;/// Map position as flat index offset (x + y * w)
@@ -324,21 +306,27 @@ public:
 	const CUnitStats *Stats;       /// Current unit stats
 	int         CurrentSightRange; /// Unit's Current Sight Range
 
-	// Pathfinding stuff:
-	PathFinderData *pathFinderData;
+	std::vector<COrder *> Orders; /// orders to process
+	CVariable *Variable; /// array of User Defined variables.
+
+	unsigned int Wait;          /// action counter
+	unsigned char ParkedAction; /// action only counting down Wait, UnitActionNone if not parked
+
+	struct _unit_anim_ {
+		const CAnimation *Anim;      /// Anim
+		const CAnimation *CurrAnim;  /// CurrAnim
+		int Wait;                    /// Wait
+		int Unbreakable;             /// Unbreakable
+	} Anim;
 
 	// DISPLAY:
 	int         Frame;      /// Image frame: <0 is mirrored
-	CUnitColors *Colors;    /// Player colors
 
 	signed char IX;         /// X image displacement to map position
 	signed char IY;         /// Y image displacement to map position
 	unsigned char Direction; //: 8; /// angle (0-255) unit looking
 	unsigned char CurrentResource;
-	int ResourcesHeld;      /// Resources Held by a unit
 
-	unsigned char DamagedType;   /// Index of damage type of unit which damaged this unit
-	unsigned long Attacked; /// gamecycle unit was last attacked
 	unsigned Blink : 3;     /// Let selection rectangle blink
 	unsigned Moving : 1;    /// The unit is moving
 	unsigned ReCast : 1;    /// Recast again next cycle
@@ -360,6 +348,38 @@ public:
 	unsigned Rs : 8;
 
 	unsigned TeamSelected;  /// unit is selected by a team member.
+
+	/* Seldom used, after. */
+	// @note int is faster than shorts
+	unsigned int     Refs;         /// Reference counter
+	unsigned int     ReleaseCycle; /// When this unit could be recycled
+	CUnitManagerData UnitManagerData;
+	size_t PlayerSlot;  /// index in Player->Units
+
+	int    InsideCount;   /// Number of units inside.
+	int    BoardCount;    /// Number of units transported inside.
+	CUnit *UnitInside;    /// Pointer to one of the units inside.
+	CUnit *Container;     /// Pointer to the unit containing it (or 0)
+	CUnit *NextContained; /// Next unit in the container.
+	CUnit *PrevContained; /// Previous unit in the container.
+
+	CUnit *NextWorker; //pointer to next assigned worker to "Goal" resource.
+	struct {
+		CUnit *Workers; /// pointer to first assigned worker to this resource.
+		int Assigned; /// how many units are assigned to harvesting from the resource.
+		int Active; /// how many units are harvesting from the resource.
+	} Resource; /// Resource still
+
+	// Pathfinding stuff:
+	PathFinderData *pathFinderData;
+
+	CUnitColors *Colors;    /// Player colors
+
+	int ResourcesHeld;      /// Resources Held by a unit
+
+	unsigned char DamagedType;   /// Index of damage type of unit which damaged this unit
+	unsigned long Attacked; /// gamecycle unit was last attacked
+
 	CPlayer *RescuedFrom;        /// The original owner of a rescued unit.
 	/// NULL if the unit was not rescued.
 	/* Seen stuff. */
@@ -378,25 +398,13 @@ public:
 		unsigned    ByPlayer : PlayerMax;   /// Track unit seen by player
 	} Seen;
 
-	CVariable *Variable; /// array of User Defined variables.
-
 	unsigned long TTL;  /// time to live
 
 	int GroupId;        /// unit belongs to this group id
 	int LastGroup;      /// unit belongs to this last group
 
-	unsigned int Wait;          /// action counter
 	int Threshold;              /// The counter while ai unit couldn't change target.
 
-	struct _unit_anim_ {
-		const CAnimation *Anim;      /// Anim
-		const CAnimation *CurrAnim;  /// CurrAnim
-		int Wait;                    /// Wait
-		int Unbreakable;             /// Unbreakable
-	} Anim;
-
-
-	std::vector<COrder *> Orders; /// orders to process
 	COrder *SavedOrder;         /// order to continue after current
 	COrder *NewOrder;           /// order for new trained units
 	COrder *CriticalOrder;      /// order to do as possible in breakable animation.
@@ -498,6 +506,8 @@ extern void UnitsOnTileUnmarkSeen(const CPlayer &player, unsigned int index, int
 
 /// Does a recount for VisCount
 extern void UnitCountSeen(CUnit &unit);
+/// Updates VisCount of a unit which has moved
+extern void UnitCountSeenMoved(CUnit &unit, const Vec2i &oldPos);
 
 /// Check for rescue each second
 extern void RescueUnits();
@@ -539,6 +549,10 @@ extern int ExtraDeathIndex(const char *death);
 
 /// @todo more docu
 extern CUnit *UnitOnScreen(CUnit *unit, int x, int y);
+/// Find the units on the map whose selection box may contain a map pixel
+extern void FindUnitsNearMapPixel(const PixelPos &pos, std::vector<CUnit *> &units);
+/// Free the grid of the units on the map
+extern void FreeUnitGrid();
 
 /// Let a unit die
 extern void LetUnitDie(CUnit &unit);
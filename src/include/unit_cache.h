@@ -46,32 +46,51 @@ class CUnit;
 class CMap;
 /**
 **  Unit cache
+**
+**  Nearly all the map fields hold no more than two units, so those are
+**  kept in the cache itself, the heap is only used by crowded fields.
 */
 class CUnitCache
 {
 public:
-	typedef std::vector<CUnit *>::iterator iterator;
-	typedef std::vector<CUnit *>::const_iterator const_iterator;
+	typedef CUnit **iterator;
+	typedef CUnit *const *const_iterator;
 
 public:
-	CUnitCache() : Units() {}
+	CUnitCache() : Size(0), Capacity(InlineSize) {}
+	CUnitCache(const CUnitCache &rhs) : Size(0), Capacity(InlineSize) {
+		Assign(rhs);
+	}
+	~CUnitCache() {
+		if (Capacity != InlineSize) {
+			delete[] Heap;
+		}
+	}
 
-	size_t size() const { return Units.size(); }
+	CUnitCache &operator=(const CUnitCache &rhs) {
+		if (this != &rhs) {
+			Size = 0;
+			Assign(rhs);
+		}
+		return *this;
+	}
+
+	size_t size() const { return Size; }
 
-	void clear() { Units.clear(); }
+	void clear() { Size = 0; }
 
-	const_iterator begin() const { return Units.begin(); }
-	iterator begin() { return Units.begin(); }
-	const_iterator end() const { return Units.end(); }
-	iterator end() { return Units.end(); }
+	const_iterator begin() const { return Data(); }
+	iterator begin() { return Data(); }
+	const_iterator end() const { return Data() + Size; }
+	iterator end() { return Data() + Size; }
 
 	CUnit *operator[](const unsigned int index) const {
-		//Assert(index < Units.size());
-		return Units[index];
+		//Assert(index < Size);
+		return Data()[index];
 	}
 	CUnit *operator[](const unsigned int index) {
-		//Assert(index < Units.size());
-		return Units[index];
+		//Assert(index < Size);
+		return Data()[index];
 	}
 
 	/**
@@ -82,9 +101,9 @@ public:
 	 */
 	template<typename _T>
 	CUnit *find(const _T &pred) const {
-		std::vector<CUnit *>::const_iterator ret = std::find_if(Units.begin(), Units.end(), pred);
+		const_iterator ret = std::find_if(begin(), end(), pred);
 
-		return ret != Units.end() ? (*ret) : NULL;
+		return ret != end() ? (*ret) : NULL;
 	}
 
 	/**
@@ -97,10 +116,11 @@ public:
 	 */
 	template<typename _T>
 	void for_each(const _T functor) {
-		const size_t size = Units.size();
+		const size_t size = Size;
+		CUnit *const *units = Data();
 
 		for (size_t i = 0; i != size; ++i) {
-			functor(Units[i]);
+			functor(units[i]);
 		}
 	}
 
@@ -115,10 +135,11 @@ public:
 	 */
 	template<typename _T>
 	int for_each_if(const _T &functor) {
-		const size_t size = Units.size();
+		const size_t size = Size;
+		CUnit *const *units = Data();
 
 		for (size_t count = 0; count != size; ++count) {
-			if (functor(Units[count]) == false) {
+			if (functor(units[count]) == false) {
 				return count;
 			}
 		}
@@ -133,13 +154,10 @@ public:
 	**  @return pointer to removed element.
 	*/
 	CUnit *Remove(const unsigned int index) {
-		const size_t size = Units.size();
-		Assert(index < size);
-		CUnit *tmp = Units[index];
-		if (size > 1) {
-			Units[index] = Units[size - 1];
-		}
-		Units.pop_back();
+		CUnit **units = Data();
+		Assert(index < Size);
+		CUnit *tmp = units[index];
+		units[index] = units[--Size];
 		return tmp;
 	}
 
@@ -149,25 +167,20 @@ public:
 	**  @param unit  Unit pointer to remove from container.
 	*/
 	bool Remove(CUnit *const unit) {
+		CUnit **units = Data();
 #ifndef SECURE_UNIT_REMOVING
-		const size_t size = Units.size();
-		if (size == 1 && unit == Units[0]) {
-			Units.pop_back();
-			return true;
-		} else {
-			for (unsigned int i = 0; i < size; ++i) {
-				// Do we care on unit sequence in tile cache ?
-				if (Units[i] == unit) {
-					Units[i] = Units[size - 1];
-					Units.pop_back();
-					return true;
-				}
+		for (unsigned int i = 0; i < Size; ++i) {
+			// Do we care on unit sequence in tile cache ?
+			if (units[i] == unit) {
+				units[i] = units[--Size];
+				return true;
 			}
 		}
 #else
-		for (std::vector<CUnit *>::iterator i(Units.begin()), end(Units.end()); i != end; ++i) {
-			if ((*i) == unit) {
-				Units.erase(i);
+		for (unsigned int i = 0; i < Size; ++i) {
+			if (units[i] == unit) {
+				std::copy(units + i + 1, units + Size, units + i);
+				--Size;
 				return true;
 			}
 		}
@@ -181,11 +194,11 @@ public:
 	**  @param unit  Unit pointer to remove from container.
 	*/
 	void RemoveS(CUnit *const unit) {
-		for (std::vector<CUnit *>::iterator i(Units.begin()), end(Units.end()); i != end; ++i) {
-			if ((*i) == unit) {
-				Units.erase(i);
-				return;
-			}
+		iterator i = std::find(begin(), end(), unit);
+
+		if (i != end()) {
+			std::copy(i + 1, end(), i);
+			--Size;
 		}
 	}
 
@@ -197,11 +210,17 @@ public:
 	**  @return false if unit is already in cache and nothing is added.
 	*/
 	bool InsertS(CUnit *unit) {
-		if (!binary_search(Units.begin(), Units.end(), unit)) {
-			Units.insert(std::lower_bound(Units.begin(), Units.end(), unit), unit);
-			return true;
+		iterator i = std::lower_bound(begin(), end(), unit);
+
+		if (i != end() && *i == unit) {
+			return false;
 		}
-		return false;
+		const size_t index = i - begin();
+		Insert(unit);
+		i = begin() + index;
+		std::copy_backward(i, end() - 1, end());
+		*i = unit;
+		return true;
 	}
 
 	/**
@@ -210,15 +229,54 @@ public:
 	**  @param unit  Unit pointer to place in cache.
 	*/
 	void Insert(CUnit *unit) {
-		Units.push_back(unit);
+		if (Size == Capacity) {
+			Reserve(2 * Capacity);
+		}
+		Data()[Size++] = unit;
 	}
 
-public:
-	std::vector<CUnit *> Units;
+private:
+	CUnit *const *Data() const { return Capacity == InlineSize ? Inline : Heap; }
+	CUnit **Data() { return Capacity == InlineSize ? Inline : Heap; }
+
+	/**
+	**  Grow the storage of the cache, moving it to the heap.
+	**
+	**  @param capacity  Number of units to make room for.
+	*/
+	void Reserve(unsigned int capacity) {
+		if (capacity <= Capacity) {
+			return;
+		}
+		CUnit **units = new CUnit *[capacity];
+		std::copy(begin(), end(), units);
+		if (Capacity != InlineSize) {
+			delete[] Heap;
+		}
+		Heap = units;
+		Capacity = capacity;
+	}
+
+	/// Append the units of another cache
+	void Assign(const CUnitCache &rhs) {
+		Reserve(rhs.Size);
+		std::copy(rhs.begin(), rhs.end(), Data());
+		Size = rhs.Size;
+	}
+
+private:
+	/// Units kept in the cache itself
+	static const unsigned int InlineSize = 2;
+
+	union {
+		CUnit *Inline[InlineSize];  /// Units, when there are few of them
+		CUnit **Heap;               /// Units, when the cache has grown
+	};
+	unsigned int Size;      /// Number of units in the cache
+	unsigned int Capacity;  /// Room for units, InlineSize when not on the heap
 };
 
 
 //@}
 
 #endif // !__UNIT_CACHE_H__
-
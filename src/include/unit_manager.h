@@ -72,9 +72,14 @@ public:
 	CUnit &GetSlotUnit(int index) const;
 	unsigned int GetUsedSlotCount() const;
 
+private:
+	CUnit *NewSlotUnit();
+	void FreeSlotUnits();
+
 private:
 	std::vector<CUnit *> units;
 	std::vector<CUnit *> unitSlots;
+	std::vector<CUnit *> slabs;        /// storage of the slots, by blocks of units
 	std::list<CUnit *> releasedUnits;
 	CUnit *lastCreated;
 };
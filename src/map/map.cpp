@@ -38,6 +38,8 @@
 
 #include "map.h"
 
+#include "editor.h"
+#include "pathfinder.h"
 #include "player.h"
 #include "tileset.h"
 #include "unit.h"
@@ -54,6 +56,19 @@ int ReplayRevealMap;             /// Reveal Map is replay
 int ForestRegeneration;          /// Forest regeneration
 char CurrentMapPath[1024];       /// Path of the current map
 
+/// Slots of ForestWheel, more than the max forest regeneration
+static const int ForestWheelSize = 256;
+/// Seconds of forest regeneration done, it doesn't run when disabled
+static unsigned long ForestCycle;
+/// Forest regeneration the cleared forest fields are scheduled with
+static int ForestScheduled;
+/// Cleared forest fields, in the slot of the second they are grown up
+static std::vector<unsigned int> ForestWheel[ForestWheelSize];
+/// Slot + 1 of each cleared forest field in ForestWheel, 0 if none
+static std::vector<unsigned short> ForestSlots;
+/// Grown up fields which can't regrow because of units on them
+static std::vector<unsigned int> ForestWaiting;
+
 /*----------------------------------------------------------------------------
 --  Visible and explored handling
 ----------------------------------------------------------------------------*/
@@ -77,6 +92,7 @@ void CMap::MarkSeenTile(const unsigned int index)
 		return;
 	}
 	mf.SeenTile = tile;
+	MapBackgroundTileChanged(index);
 
 #ifdef MINIMAP_UPDATE
 	//rb - GRRRRRRRRRRRR
@@ -135,14 +151,26 @@ void CMap::Reveal()
 	Vec2i pos;
 	for (pos.x = 0; pos.x < this->Info.MapWidth; ++pos.x) {
 		for (pos.y = 0; pos.y < this->Info.MapHeight; ++pos.y) {
+			const unsigned int index = getIndex(pos);
 			for (int p = 0; p < PlayerMax; ++p) {
-				if (!this->Field(pos)->Visible[p]) {
-					this->Field(pos)->Visible[p] = 1;
+				if (!HasPlayerCounters(p)) {
+					continue;
+				}
+				if (!this->Visible[p][index]) {
+					this->Visible[p][index] = 1;
+				}
+				if (!this->EffectiveVisible[p][index]) {
+					this->EffectiveVisible[p][index] = 1;
 				}
 			}
 			MarkSeenTile(pos);
 		}
 	}
+	for (int p = 0; p < PlayerMax; ++p) {
+		PathCacheTerrainExplored(p);
+	}
+	FogOfWarChanged();
+	UI.Minimap.Invalidate();
 	//  Global seen recount. Simple and effective.
 	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
 		CUnit &unit = **it;
@@ -203,31 +231,105 @@ bool CMap::IsTerrainResourceOnMap(const Vec2i &pos) const
 
 unsigned short CMap::IsTileVisible(const CPlayer &player, const unsigned int index) const
 {
-	const CMapField &mf = this->Fields[index];
-	unsigned short visiontype = mf.Visible[player.Index];
+	const unsigned char visiontype = this->EffectiveVisible[player.Index][index];
 
-	if (visiontype > 1) {
-		return visiontype;
+	if (visiontype == 1 && NoFogOfWar) {
+		return 2;
 	}
-	if (player.IsVisionSharing()) {
-		for (int i = 0; i < PlayerMax ; ++i) {
+	return visiontype;
+}
+
+/**
+**  Compute the vision of a field by a player, with the fields seen by
+**  the players sharing vision with him.
+**
+**  @return  0 unexplored, 1 explored, 2 visible.
+*/
+static unsigned char ComputeEffectiveVisible(const CPlayer &player, const unsigned int index)
+{
+	unsigned char visiontype = std::min<unsigned short>(Map.Visible[player.Index][index], 2);
+
+	if (visiontype < 2 && player.IsVisionSharing()) {
+		for (int i = 0; i < PlayerMax; ++i) {
 			if (player.IsBothSharedVision(Players[i])) {
-				if (mf.Visible[i] > 1) {
+				if (Map.Visible[i][index] > 1) {
 					return 2;
 				}
-				visiontype |= mf.Visible[i];
+				visiontype |= Map.Visible[i][index];
 			}
 		}
 	}
-	if (visiontype) {
-		return visiontype + (NoFogOfWar ? 1 : 0);
+	return visiontype;
+}
+
+/**
+**  Set the effective vision of a field by a player.
+**
+**  The fog of war of the field is drawn again when the vision of the
+**  player on this computer changes.
+*/
+static void SetEffectiveVisible(const CPlayer &player, const unsigned int index)
+{
+	// A player not in use may still share vision, but has no counters.
+	if (!Map.HasPlayerCounters(player.Index)) {
+		return;
+	}
+	const unsigned char visiontype = ComputeEffectiveVisible(player, index);
+	unsigned char &effective = Map.EffectiveVisible[player.Index][index];
+
+	if (effective != visiontype) {
+		effective = visiontype;
+		if (&player == ThisPlayer) {
+			FogOfWarTileChanged(index);
+			UI.Minimap.UpdateSeenXY(Vec2i(index % Map.Info.MapWidth, index / Map.Info.MapWidth));
+		}
+	}
+}
+
+/**
+**  Rebuild the effective vision of all players.
+**
+**  Must be called when the shared vision changes.
+*/
+void CMap::InitEffectiveVisible()
+{
+	const unsigned int size = this->Info.MapWidth * this->Info.MapHeight;
+
+	for (int p = 0; p < PlayerMax; ++p) {
+		if (!HasPlayerCounters(p)) {
+			continue;
+		}
+		for (unsigned int index = 0; index != size; ++index) {
+			this->EffectiveVisible[p][index] = ComputeEffectiveVisible(Players[p], index);
+		}
+	}
+	FogOfWarChanged();
+	UI.Minimap.Invalidate();
+}
+
+/**
+**  The vision of a field by a player has changed between unexplored,
+**  explored and visible. Update the effective vision of this player
+**  and of the players sharing vision with him.
+**
+**  @param player  Player whose vision has changed.
+**  @param index   flat tile index adress.
+*/
+void CMap::UpdateEffectiveVisible(const CPlayer &player, const unsigned int index)
+{
+	SetEffectiveVisible(player, index);
+	if (player.IsVisionSharing()) {
+		for (int i = 0; i < PlayerMax; ++i) {
+			if (i != player.Index && player.IsBothSharedVision(Players[i])) {
+				SetEffectiveVisible(Players[i], index);
+			}
+		}
 	}
-	return 0;
 }
 
 bool CMap::IsFieldExplored(const CPlayer &player, const unsigned int index) const
 {
-	return this->Fields[index].IsExplored(player.Index);
+	return this->Visible[player.Index][index] != 0;
 }
 
 
@@ -345,6 +447,8 @@ void PreprocessMap()
 			}
 		}
 	}
+	// All the seen tiles have changed.
+	FreeMapBackground();
 }
 
 /**
@@ -366,8 +470,69 @@ void CMapInfo::Clear()
 void CMap::Create()
 {
 	Assert(!this->Fields);
+	Assert(this->Info.MapWidth <= MaxMapWidth && this->Info.MapHeight <= MaxMapHeight);
+
+	const unsigned int size = this->Info.MapWidth * this->Info.MapHeight;
 
-	this->Fields = new CMapField[this->Info.MapWidth * this->Info.MapHeight];
+	this->Fields = new CMapField[size];
+
+	// Players not in use have no unit, they share a plane of zeros for
+	// each kind of counter, the first one of the kind. The editor can
+	// change the players at any time, it gives a plane to all of them.
+	bool inUse[PlayerMax];
+	int planeCount = 1;
+	for (int i = 0; i < PlayerMax; ++i) {
+		inUse[i] = Editor.Running != EditorNotRunning || Players[i].Type != PlayerNobody;
+		if (inUse[i]) {
+			++planeCount;
+		}
+	}
+	// Visible first, the block is aligned for its unsigned shorts.
+	const unsigned int planesSize = planeCount * size;
+	this->PlayerCounters = new unsigned char[planesSize * (sizeof(unsigned short) + 4)];
+	memset(this->PlayerCounters, 0, planesSize * (sizeof(unsigned short) + 4));
+
+	unsigned short *visible = reinterpret_cast<unsigned short *>(this->PlayerCounters);
+	unsigned char *effectiveVisible = this->PlayerCounters + planesSize * sizeof(unsigned short);
+	unsigned char *visCloak = effectiveVisible + planesSize;
+	unsigned char *radar = visCloak + planesSize;
+	unsigned char *radarJammer = radar + planesSize;
+	int plane = 1;
+	for (int i = 0; i < PlayerMax; ++i) {
+		const unsigned int offset = inUse[i] ? plane++ * size : 0;
+
+		this->Visible[i] = visible + offset;
+		this->EffectiveVisible[i] = effectiveVisible + offset;
+		this->VisCloak[i] = visCloak + offset;
+		this->Radar[i] = radar + offset;
+		this->RadarJammer[i] = radarJammer + offset;
+	}
+	this->RadarPlayers = new unsigned int[size];
+	this->RadarJammerPlayers = new unsigned int[size];
+	memset(this->RadarPlayers, 0, size * sizeof(unsigned int));
+	memset(this->RadarJammerPlayers, 0, size * sizeof(unsigned int));
+}
+
+/**
+**  Free the map table.
+*/
+void CMap::FreeFields()
+{
+	delete[] this->Fields;
+	delete[] this->PlayerCounters;
+	delete[] this->RadarPlayers;
+	delete[] this->RadarJammerPlayers;
+
+	this->Fields = NULL;
+	this->PlayerCounters = NULL;
+	memset(this->Visible, 0, sizeof(this->Visible));
+	memset(this->EffectiveVisible, 0, sizeof(this->EffectiveVisible));
+	memset(this->VisCloak, 0, sizeof(this->VisCloak));
+	memset(this->Radar, 0, sizeof(this->Radar));
+	memset(this->RadarJammer, 0, sizeof(this->RadarJammer));
+	this->RadarPlayers = NULL;
+	this->RadarJammerPlayers = NULL;
+	FreeUnitGrid();
 }
 
 /**
@@ -376,21 +541,41 @@ void CMap::Create()
 */
 void CMap::Init()
 {
+	if (this->Fields) {
+		InitEffectiveVisible();
+		InitForestRegeneration();
+	}
 	InitFogOfWar();
 }
 
 
+/**
+**  Free the forest regeneration schedule.
+*/
+static void FreeForestRegeneration()
+{
+	for (int i = 0; i != ForestWheelSize; ++i) {
+		ForestWheel[i].clear();
+	}
+	ForestWaiting.clear();
+	ForestSlots.clear();
+	ForestScheduled = 0;
+	ForestCycle = 0;
+}
+
+
 /**
 **  Cleanup the map module.
 */
 void CMap::Clean()
 {
-	delete[] this->Fields;
+	this->FreeFields();
+	FreeForestRegeneration();
+	FreeMapBackground();
 
 	// Tileset freed by Tileset?
 
 	this->Info.Clear();
-	this->Fields = NULL;
 	this->NoFogOfWar = false;
 	this->Tileset.Clear();
 	this->TileModelsFileName.clear();
@@ -539,11 +724,14 @@ void CMap::FixTile(unsigned short type, int seen, const Vec2i &pos)
 	if (tile == -1) { // No valid wood remove it.
 		if (seen) {
 			mf->SeenTile = removedtile;
+			MapBackgroundTileChanged(index);
 			this->FixNeighbors(type, seen, pos);
 		} else {
 			mf->Tile = removedtile;
 			mf->Flags &= ~flags;
 			mf->Value = 0;
+			ScheduleForestRegeneration(index);
+			PathfinderTilesChanged(pos, 1, 1);
 			UI.Minimap.UpdateXY(pos);
 		}
 	} else if (seen && this->Tileset.MixedLookupTable[mf->SeenTile] ==
@@ -552,6 +740,7 @@ void CMap::FixTile(unsigned short type, int seen, const Vec2i &pos)
 	} else {
 		if (seen) {
 			mf->SeenTile = tile;
+			MapBackgroundTileChanged(index);
 		} else {
 			mf->Tile = tile;
 		}
@@ -614,6 +803,8 @@ void CMap::ClearTile(unsigned short type, const Vec2i &pos)
 	mf.Tile = removedtile;
 	mf.Flags &= ~flags;
 	mf.Value = 0;
+	ScheduleForestRegeneration(index);
+	PathfinderTilesChanged(pos, 1, 1);
 
 	UI.Minimap.UpdateXY(pos);
 	FixNeighbors(type, 0, pos);
@@ -625,68 +816,172 @@ void CMap::ClearTile(unsigned short type, const Vec2i &pos)
 	}
 }
 
+/**
+**  Schedule the regeneration of a field, if it is cleared forest.
+**
+**  The field grows up when CMapField::Value reaches the forest
+**  regeneration. Until then Value isn't updated, see GetFieldValue.
+**
+**  @param index  flat tile index adress.
+*/
+void CMap::ScheduleForestRegeneration(const unsigned int index)
+{
+	if (ForestSlots.empty()) {
+		return;
+	}
+	// Forget the previous schedule of the field.
+	ForestSlots[index] = 0;
+
+	const CMapField &mf = *this->Field(index);
+	if (!ForestScheduled || mf.Tile != this->Tileset.RemovedTree) {
+		return;
+	}
+	const int delay = std::max(ForestScheduled - mf.Value, 1);
+	const int slot = (ForestCycle + delay) % ForestWheelSize;
+
+	ForestWheel[slot].push_back(index);
+	ForestSlots[index] = slot + 1;
+}
+
+/**
+**  Value of a field, with the regeneration of cleared forest.
+**
+**  @param index  flat tile index adress.
+**
+**  @return       CMapField::Value, as if updated each second.
+*/
+unsigned char CMap::GetFieldValue(const unsigned int index) const
+{
+	const CMapField &mf = *this->Field(index);
+
+	// The fields grown up are updated the next second.
+	if (ForestSlots.empty() || !ForestSlots[index] || mf.Value >= ForestScheduled) {
+		return mf.Value;
+	}
+	const int remaining = (ForestSlots[index] - 1 - ForestCycle % ForestWheelSize + ForestWheelSize) % ForestWheelSize;
+	return std::max(ForestScheduled - remaining, 0);
+}
+
+/**
+**  Schedule the regeneration of all the cleared forest.
+**
+**  Must be called when the map is loaded and when the forest
+**  regeneration changes.
+*/
+void CMap::InitForestRegeneration()
+{
+	const unsigned int size = this->Info.MapWidth * this->Info.MapHeight;
+
+	// Keep the regeneration done so far.
+	if (ForestSlots.size() == size) {
+		for (unsigned int index = 0; index != size; ++index) {
+			if (ForestSlots[index]) {
+				this->Field(index)->Value = GetFieldValue(index);
+			}
+		}
+	}
+	for (int i = 0; i != ForestWheelSize; ++i) {
+		ForestWheel[i].clear();
+	}
+	ForestWaiting.clear();
+	ForestSlots.assign(size, 0);
+	ForestScheduled = ForestRegeneration;
+	for (unsigned int index = 0; index != size; ++index) {
+		ScheduleForestRegeneration(index);
+	}
+}
+
 /**
 **  Regenerate forest.
 **
-**  @param pos  Map tile pos
+**  @param pos  Map tile pos, a grown up cleared forest field.
+**
+**  @return     true if the forest can't regrow only because of units.
 */
-void CMap::RegenerateForestTile(const Vec2i &pos)
+bool CMap::RegenerateForestTile(const Vec2i &pos)
 {
 	Assert(Map.Info.IsPointOnMap(pos));
 	CMapField &mf = *this->Field(pos);
 
-	if (mf.Tile != this->Tileset.RemovedTree) {
-		return;
+	if (mf.Tile != this->Tileset.RemovedTree || mf.Value < ForestRegeneration) {
+		return false;
 	}
 
-	//  Increment each value of no wood.
-	//  If grown up, place new wood.
+	//  If grown up with the field above, place new wood.
 	//  FIXME: a better looking result would be fine
 	//    Allow general updates to any tiletype that regrows
 
 	const unsigned int occupedFlag = (MapFieldWall | MapFieldUnpassable | MapFieldLandUnit | MapFieldBuilding);
-	++mf.Value;
-	if (mf.Value < ForestRegeneration) {
-		return;
-	}
-	mf.Value = ForestRegeneration;
-	if ((mf.Flags & occupedFlag) || pos.y == 0) {
-		return;
+	if (pos.y == 0) {
+		return false;
 	}
 	CMapField &topMf = *(&mf - this->Info.MapWidth);
-	if (topMf.Tile == this->Tileset.RemovedTree
-		&& topMf.Value >= ForestRegeneration
-		&& !(topMf.Flags & occupedFlag)) {
-		DebugPrint("Real place wood\n");
-		topMf.Tile = this->Tileset.TopOneTree;
-		topMf.Value = 0;
-		topMf.Flags |= MapFieldForest | MapFieldUnpassable;
-
-		mf.Tile = this->Tileset.BotOneTree;
-		mf.Value = 0;
-		mf.Flags |= MapFieldForest | MapFieldUnpassable;
-		if (Map.IsFieldVisible(*ThisPlayer, pos)) {
-			MarkSeenTile(pos);
-		}
-		const Vec2i offset(0, -1);
-		if (Map.IsFieldVisible(*ThisPlayer, pos + offset)) {
-			MarkSeenTile(pos);
-		}
+	if (topMf.Tile != this->Tileset.RemovedTree || topMf.Value < ForestRegeneration) {
+		// It regrows when the field above is grown up.
+		return false;
 	}
+	if ((mf.Flags & occupedFlag) || (topMf.Flags & occupedFlag)) {
+		return true;
+	}
+	DebugPrint("Real place wood\n");
+	topMf.Tile = this->Tileset.TopOneTree;
+	topMf.Value = 0;
+	topMf.Flags |= MapFieldForest | MapFieldUnpassable;
+
+	mf.Tile = this->Tileset.BotOneTree;
+	mf.Value = 0;
+	mf.Flags |= MapFieldForest | MapFieldUnpassable;
+	PathfinderTilesChanged(pos - Vec2i(0, 1), 1, 2);
+	if (Map.IsFieldVisible(*ThisPlayer, pos)) {
+		MarkSeenTile(pos);
+	}
+	const Vec2i offset(0, -1);
+	if (Map.IsFieldVisible(*ThisPlayer, pos + offset)) {
+		MarkSeenTile(pos);
+	}
+	return false;
 }
 
 /**
 **  Regenerate forest.
+**
+**  Only the fields grown up this second, the fields under them and
+**  the fields waiting for units to leave are checked.
 */
 void CMap::RegenerateForest()
 {
-	if (!ForestRegeneration) {
+	if (!ForestRegeneration || ForestSlots.empty()) {
 		return;
 	}
-	Vec2i pos;
-	for (pos.y = 0; pos.y < Info.MapHeight; ++pos.y) {
-		for (pos.x = 0; pos.x < Info.MapWidth; ++pos.x) {
-			RegenerateForestTile(pos);
+	++ForestCycle;
+	std::vector<unsigned int> &due = ForestWheel[ForestCycle % ForestWheelSize];
+	std::vector<unsigned int> fields;
+
+	fields.swap(ForestWaiting);
+	for (size_t i = 0; i != due.size(); ++i) {
+		const unsigned int index = due[i];
+
+		// Skip the fields scheduled again since.
+		if (ForestSlots[index] != ForestCycle % ForestWheelSize + 1) {
+			continue;
+		}
+		ForestSlots[index] = 0;
+		this->Field(index)->Value = ForestRegeneration;
+		fields.push_back(index);
+		if (index + this->Info.MapWidth < ForestSlots.size()) {
+			fields.push_back(index + this->Info.MapWidth);
+		}
+	}
+	due.clear();
+
+	// Same order as a scan of the whole map.
+	std::sort(fields.begin(), fields.end());
+	fields.erase(std::unique(fields.begin(), fields.end()), fields.end());
+	for (size_t i = 0; i != fields.size(); ++i) {
+		const Vec2i pos(fields[i] % this->Info.MapWidth, fields[i] / this->Info.MapWidth);
+
+		if (RegenerateForestTile(pos)) {
+			ForestWaiting.push_back(fields[i]);
 		}
 	}
 }
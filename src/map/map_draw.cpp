@@ -44,6 +44,7 @@
 #include "unittype.h"
 #include "ui.h"
 #include "video.h"
+#include "../video/intern_video.h"
 
 
 CViewport::CViewport() : MapWidth(0), MapHeight(0), Unit(NULL)
@@ -212,6 +213,189 @@ void CViewport::Center(const PixelPos &mapPixelPos)
 	this->Set(mapPixelPos - this->GetPixelSize() / 2);
 }
 
+/*----------------------------------------------------------------------------
+--  Map background chunks
+----------------------------------------------------------------------------*/
+
+/// Side of a chunk of the map background, in tiles
+static const int MapChunkSize = 16;
+/// Max number of chunks kept, enough for the viewports of a big screen
+static const size_t MapChunkMax = 48;
+
+/**
+**  Tiles of a square of the map, drawn once for the software renderer.
+*/
+struct MapChunk {
+	int Index;               /// Chunk of the map, -1 if unused
+	SDL_Surface *Surface;    /// Tiles drawn
+	bool Dirty;              /// Tiles to draw again
+	unsigned long LastUsed;  /// Frame when last drawn on the screen
+};
+
+/// Chunks kept
+static std::vector<MapChunk> MapChunks;
+/// Slot in MapChunks of each chunk of the map, -1 if none
+static std::vector<int> MapChunkSlots;
+/// Number of chunks in a row of the map
+static int MapChunkColumns;
+
+/**
+**  Free the drawn chunks of the map background.
+*/
+void FreeMapBackground()
+{
+	for (size_t i = 0; i != MapChunks.size(); ++i) {
+		SDL_FreeSurface(MapChunks[i].Surface);
+	}
+	MapChunks.clear();
+	MapChunkSlots.clear();
+	MapChunkColumns = 0;
+}
+
+/**
+**  The tile drawn on a field has changed, draw its chunk again.
+**
+**  @param index  flat index of the field.
+*/
+void MapBackgroundTileChanged(unsigned int index)
+{
+	if (MapChunkSlots.empty()) {
+		return;
+	}
+	const int x = index % Map.Info.MapWidth;
+	const int y = index / Map.Info.MapWidth;
+	const int slot = MapChunkSlots[x / MapChunkSize + (y / MapChunkSize) * MapChunkColumns];
+
+	if (slot != -1) {
+		MapChunks[slot].Dirty = true;
+	}
+}
+
+/**
+**  Draw the tiles of a chunk in its surface.
+*/
+static void DrawMapChunkTiles(MapChunk &chunk)
+{
+	const int x0 = (chunk.Index % MapChunkColumns) * MapChunkSize;
+	const int y0 = (chunk.Index / MapChunkColumns) * MapChunkSize;
+	const int w = chunk.Surface->w / PixelTileSize.x;
+	const int h = chunk.Surface->h / PixelTileSize.y;
+
+	for (int y = 0; y < h; ++y) {
+		const CMapField *mf = Map.Field(x0, y0 + y);
+
+		for (int x = 0; x < w; ++x, ++mf) {
+			const unsigned short tile = mf->SeenTile;
+			SDL_Rect srect = {Sint16(Map.TileGraphic->frame_map[tile].x), Sint16(Map.TileGraphic->frame_map[tile].y),
+							  Uint16(PixelTileSize.x), Uint16(PixelTileSize.y)};
+			SDL_Rect drect = {Sint16(x * PixelTileSize.x), Sint16(y * PixelTileSize.y), 0, 0};
+
+			SDL_BlitSurface(Map.TileGraphic->Surface, &srect, chunk.Surface, &drect);
+		}
+	}
+	chunk.Dirty = false;
+}
+
+/**
+**  Get a chunk of the map with its tiles drawn.
+**
+**  The chunk not drawn on the screen for the longest time is reused
+**  when too many are kept.
+**
+**  @param index  Chunk of the map.
+*/
+static const MapChunk &GetMapChunk(int index)
+{
+	if (MapChunkSlots.empty()) {
+		MapChunkColumns = (Map.Info.MapWidth + MapChunkSize - 1) / MapChunkSize;
+		const int rows = (Map.Info.MapHeight + MapChunkSize - 1) / MapChunkSize;
+		MapChunkSlots.assign(MapChunkColumns * rows, -1);
+	}
+	int slot = MapChunkSlots[index];
+
+	if (slot == -1) {
+		if (MapChunks.size() < MapChunkMax) {
+			MapChunk chunk;
+
+			chunk.Surface = NULL;
+			MapChunks.push_back(chunk);
+			slot = MapChunks.size() - 1;
+		} else {
+			slot = 0;
+			for (size_t i = 1; i != MapChunks.size(); ++i) {
+				if (MapChunks[i].LastUsed < MapChunks[slot].LastUsed) {
+					slot = i;
+				}
+			}
+			MapChunkSlots[MapChunks[slot].Index] = -1;
+		}
+		MapChunk &chunk = MapChunks[slot];
+		// Chunks at the right and bottom edges may be smaller.
+		const int w = std::min(MapChunkSize, Map.Info.MapWidth - (index % MapChunkColumns) * MapChunkSize);
+		const int h = std::min(MapChunkSize, Map.Info.MapHeight - (index / MapChunkColumns) * MapChunkSize);
+
+		if (!chunk.Surface || chunk.Surface->w != w * PixelTileSize.x || chunk.Surface->h != h * PixelTileSize.y) {
+			SDL_FreeSurface(chunk.Surface);
+			const SDL_PixelFormat *f = TheScreen->format;
+			chunk.Surface = SDL_CreateRGBSurface(SDL_SWSURFACE, w * PixelTileSize.x, h * PixelTileSize.y,
+												 f->BitsPerPixel, f->Rmask, f->Gmask, f->Bmask, 0);
+		}
+		chunk.Index = index;
+		chunk.Dirty = true;
+		MapChunkSlots[index] = slot;
+	}
+	MapChunk &chunk = MapChunks[slot];
+
+	chunk.LastUsed = FrameCounter;
+	if (chunk.Dirty) {
+		DrawMapChunkTiles(chunk);
+	}
+	return chunk;
+}
+
+/**
+**  Draw the map background of a viewport with the chunks.
+**
+**  One blit for each chunk in the viewport, instead of one for each tile.
+**
+**  @param vp  Viewport to draw.
+*/
+static void DrawMapBackgroundChunks(const CViewport &vp)
+{
+	const int columns = (Map.Info.MapWidth + MapChunkSize - 1) / MapChunkSize;
+	const int rows = (Map.Info.MapHeight + MapChunkSize - 1) / MapChunkSize;
+	const int sx = std::max(0, vp.MapPos.x / MapChunkSize);
+	const int sy = std::max(0, vp.MapPos.y / MapChunkSize);
+	// Last tiles in the viewport, as in DrawMapBackgroundInViewport.
+	const int lastx = vp.MapPos.x + (vp.BottomRightPos.x - vp.TopLeftPos.x + vp.Offset.x) / PixelTileSize.x;
+	const int lasty = vp.MapPos.y + (vp.BottomRightPos.y - vp.TopLeftPos.y + vp.Offset.y) / PixelTileSize.y;
+	const int ex = std::min(columns - 1, lastx / MapChunkSize);
+	const int ey = std::min(rows - 1, lasty / MapChunkSize);
+
+	if (lastx < 0 || lasty < 0) {
+		return;
+	}
+
+	for (int cy = sy; cy <= ey; ++cy) {
+		for (int cx = sx; cx <= ex; ++cx) {
+			const MapChunk &chunk = GetMapChunk(cx + cy * columns);
+			int x = vp.TopLeftPos.x - vp.Offset.x + (cx * MapChunkSize - vp.MapPos.x) * PixelTileSize.x;
+			int y = vp.TopLeftPos.y - vp.Offset.y + (cy * MapChunkSize - vp.MapPos.y) * PixelTileSize.y;
+			int w = chunk.Surface->w;
+			int h = chunk.Surface->h;
+			const int oldx = x;
+			const int oldy = y;
+
+			CLIP_RECTANGLE(x, y, w, h);
+
+			SDL_Rect srect = {Sint16(x - oldx), Sint16(y - oldy), Uint16(w), Uint16(h)};
+			SDL_Rect drect = {Sint16(x), Sint16(y), 0, 0};
+
+			SDL_BlitSurface(chunk.Surface, &srect, TheScreen, &drect);
+		}
+	}
+}
+
 /**
 **  Draw the map backgrounds.
 **
@@ -246,6 +430,14 @@ void CViewport::DrawMapBackgroundInViewport() const
 	const int map_max = Map.Info.MapWidth * Map.Info.MapHeight;
 	unsigned short int tile;
 
+#ifndef DEBUGMAPDRAW
+	// The revealed map draws the real tiles, they are not in the chunks.
+	if (!UseOpenGL && !ReplayRevealMap) {
+		DrawMapBackgroundChunks(*this);
+		return;
+	}
+#endif
+
 	while (sy  < 0) {
 		sy++;
 		dy += PixelTileSize.y;
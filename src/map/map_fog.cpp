@@ -40,6 +40,7 @@
 #include "map.h"
 
 #include "minimap.h"
+#include "pathfinder.h"
 #include "player.h"
 #include "tileset.h"
 #include "ui.h"
@@ -68,11 +69,45 @@ static const int FogTable[16] = {
 	0, 11, 10, 2,  13, 6, 14, 3,  12, 15, 4, 1,  8, 9, 7, 0,
 };
 
-static unsigned short *VisibleTable;
+/**
+**  Fog of war of a viewport, composed for the software renderer.
+**
+**  The fog of each tile is composed once in the layer, and the layer is
+**  drawn with one blit for each run of tiles with fog. Only the tiles
+**  whose fog has changed are composed again, and scrolling moves the
+**  layer so only the tiles coming into view are composed.
+*/
+struct FogOfWarLayer {
+	const CViewport *Viewport;  /// Viewport drawn with the layer
+	Vec2i MapPos;               /// Map tile of the top left tile of the layer
+	int Player;                 /// Player the fog is composed for
+	bool NoFogOfWar;            /// Fog of war disabled when composed
+	int Width;                  /// Width in tiles
+	int Height;                 /// Height in tiles
+	SDL_Surface *Surface;       /// Composed fog, with alpha
+	std::vector<char> Dirty;    /// Tiles to compose again
+	std::vector<char> Fogged;   /// Tiles with fog to draw
+};
+
+/// Fog of war layer of each viewport
+static std::vector<FogOfWarLayer> FogOfWarLayers;
+
+/// Sight stencil of each range, see GetSightStencil
+static std::vector<std::vector<int> > SightStencils;
 
 static SDL_Surface *OnlyFogSurface;
 static CGraphic *AlphaFogG;
 
+/// Tiles in a row of the fog of war atlas, one for each frame of the fog graphic
+static const int FogOfWarAtlasColumns = 16;
+/// Row of the atlas for the explored tiles which aren't visible
+static const int FogOfWarAtlasOnlyFogRow = 16;
+
+/// Fog of each pair of alpha fog and fog frames, composed when first used
+static SDL_Surface *FogOfWarAtlas;
+/// Tiles of the atlas already composed
+static std::vector<char> FogOfWarAtlasComposed;
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -131,14 +166,17 @@ int MapFogFilterFlags(CPlayer &player, const Vec2i &pos, int mask)
 */
 void MapMarkTileSight(const CPlayer &player, const unsigned int index)
 {
-	//v = &Map.Field(x, y)->Visible[player.Index];
-	unsigned short *v = &(Map.Field(index)->Visible[player.Index]);
+	unsigned short *v = &Map.Visible[player.Index][index];
 	if (*v == 0 || *v == 1) { // Unexplored or unseen
 		// When there is no fog only unexplored tiles are marked.
 		if (!Map.NoFogOfWar || *v == 0) {
 			UnitsOnTileMarkSeen(player, index, 0);
 		}
+		if (*v == 0) {
+			PathCacheTerrainExplored(player.Index);
+		}
 		*v = 2;
+		Map.UpdateEffectiveVisible(player, index);
 		if (Map.IsTileVisible(*ThisPlayer, index) > 1) {
 			Map.MarkSeenTile(index);
 		}
@@ -164,7 +202,7 @@ void MapMarkTileSight(const CPlayer &player, const Vec2i &pos)
 */
 void MapUnmarkTileSight(const CPlayer &player, const unsigned int index)
 {
-	unsigned short *v = &(Map.Field(index)->Visible[player.Index]);
+	unsigned short *v = &Map.Visible[player.Index][index];
 	switch (*v) {
 		case 0:  // Unexplored
 		case 1:
@@ -179,6 +217,9 @@ void MapUnmarkTileSight(const CPlayer &player, const unsigned int index)
 			if (Map.IsTileVisible(*ThisPlayer, index) > 1) {
 				Map.MarkSeenTile(index);
 			}
+			--*v;
+			Map.UpdateEffectiveVisible(player, index);
+			break;
 		default:  // seen -> seen
 			--*v;
 			break;
@@ -201,7 +242,7 @@ void MapUnmarkTileSight(const CPlayer &player, const Vec2i &pos)
 */
 void MapMarkTileDetectCloak(const CPlayer &player, const unsigned int index)
 {
-	unsigned char *v = &(Map.Field(index)->VisCloak[player.Index]);
+	unsigned char *v = &Map.VisCloak[player.Index][index];
 	if (*v == 0) {
 		UnitsOnTileMarkSeen(player, index, 1);
 	}
@@ -225,7 +266,7 @@ void MapMarkTileDetectCloak(const CPlayer &player, const Vec2i &pos)
 void
 MapUnmarkTileDetectCloak(const CPlayer &player, const unsigned int index)
 {
-	unsigned char *v = &(Map.Field(index)->VisCloak[player.Index]);
+	unsigned char *v = &Map.VisCloak[player.Index][index];
 	Assert(*v != 0);
 	if (*v == 1) {
 		UnitsOnTileUnmarkSeen(player, index, 1);
@@ -238,6 +279,121 @@ void MapUnmarkTileDetectCloak(const CPlayer &player, const Vec2i &pos)
 	MapUnmarkTileDetectCloak(player, Map.getIndex(pos));
 }
 
+/**
+**  Get the sight stencil of a range.
+**
+**  The stencil gives for each row of a sight circle how far it goes
+**  left and right of the unit: row k is k tiles above the unit or k + 1
+**  tiles under it, row 0 also covers the rows of the unit. The size of
+**  the unit only shifts the rows, so a stencil serves every unit size.
+**
+**  @param range  Radius of the sight.
+**
+**  @return       Offsets of the rows, valid until a bigger range is asked.
+*/
+static const std::vector<int> &GetSightStencil(int range)
+{
+	if (range >= (int)SightStencils.size()) {
+		SightStencils.resize(range + 1);
+	}
+	std::vector<int> &stencil = SightStencils[range];
+	if (stencil.empty()) {
+		stencil.resize(range + 1);
+		for (int k = 0; k <= range; ++k) {
+			stencil[k] = isqrt(square(range + 1) - square(k) - 1);
+		}
+	}
+	return stencil;
+}
+
+/**
+**  Get how far a row of a sight circle goes left and right of the unit.
+**
+**  @param stencil  Stencil of the range.
+**  @param h        height of the unit, in square
+**  @param offsety  Row, relative to the top of the unit.
+*/
+static inline int GetSightOffset(const std::vector<int> &stencil, int h, int offsety)
+{
+	if (offsety < 0) {
+		return stencil[-offsety];
+	}
+	return stencil[offsety < h ? 0 : offsety - h];
+}
+
+/**
+**  Mark the tiles [minx, maxx) of a row.
+*/
+static inline void MapSightSpan(const CPlayer &player, int y, int minx, int maxx, MapMarkerFunc *marker)
+{
+#ifdef MARKER_ON_INDEX
+	const unsigned int end = y * Map.Info.MapWidth + maxx;
+
+	for (unsigned int index = y * Map.Info.MapWidth + minx; index < end; ++index) {
+		marker(player, index);
+	}
+#else
+	for (Vec2i mpos(minx, y); mpos.x < maxx; ++mpos.x) {
+		marker(player, mpos);
+	}
+#endif
+}
+
+/**
+**  Mark the rows of a sight with a function marking tiles.
+*/
+class MapTileMarker
+{
+public:
+	explicit MapTileMarker(MapMarkerFunc *marker) : marker(marker) {}
+
+	void operator()(const CPlayer &player, int y, int minx, int maxx) const {
+		MapSightSpan(player, y, minx, maxx, marker);
+	}
+private:
+	MapMarkerFunc *marker;
+};
+
+/**
+**  Mark the rows of a sight with a function marking spans.
+*/
+class MapSpanMarker
+{
+public:
+	explicit MapSpanMarker(MapSpanMarkerFunc *marker) : marker(marker) {}
+
+	void operator()(const CPlayer &player, int y, int minx, int maxx) const {
+		if (minx < maxx) {
+			marker(player, y * Map.Info.MapWidth + minx, y * Map.Info.MapWidth + maxx);
+		}
+	}
+private:
+	MapSpanMarkerFunc *marker;
+};
+
+/**
+**  Mark the rows of the sight of a unit.
+*/
+template <typename T>
+static void MapSightRows(const CPlayer &player, const Vec2i &pos, int w, int h, int range, const T &marker)
+{
+	// Units under construction have no sight range.
+	if (!range) {
+		return;
+	}
+	const std::vector<int> &stencil = GetSightStencil(range);
+	const int miny = std::max(-range, 0 - pos.y);
+	const int maxy = std::min(h + range, Map.Info.MapHeight - pos.y);
+
+	for (int offsety = miny; offsety < maxy; ++offsety) {
+		const int offsetx = GetSightOffset(stencil, h, offsety);
+		const int minx = std::max(0, pos.x - offsetx);
+		const int maxx = std::min(Map.Info.MapWidth, pos.x + w + offsetx);
+
+		marker(player, pos.y + offsety, minx, maxx);
+	}
+}
+
 /**
 **  Mark the sight of unit. (Explore and make visible.)
 **
@@ -249,65 +405,107 @@ void MapUnmarkTileDetectCloak(const CPlayer &player, const Vec2i &pos)
 **  @param marker  Function to mark or unmark sight
 */
 void MapSight(const CPlayer &player, const Vec2i &pos, int w, int h, int range, MapMarkerFunc *marker)
+{
+	MapSightRows(player, pos, w, h, range, MapTileMarker(marker));
+}
+
+/**
+**  Mark the sight of unit, a row of tiles at once.
+**
+**  @param marker  Function to mark or unmark the spans of the sight
+*/
+void MapSight(const CPlayer &player, const Vec2i &pos, int w, int h, int range, MapSpanMarkerFunc *marker)
+{
+	MapSightRows(player, pos, w, h, range, MapSpanMarker(marker));
+}
+
+/**
+**  Get the tiles of a row in the sight of a unit, as MapSight marks them.
+**
+**  @param stencil  Stencil of the range.
+**  @param pos      location of the unit
+**  @param w        width of the unit, in square
+**  @param h        height of the unit, in square
+**  @param y        Row, on the map.
+**  @param minx     First tile of the row in sight.
+**  @param maxx     After the last tile of the row in sight.
+**
+**  @return         false if no tile of the row is in sight.
+*/
+static bool GetSightSpan(const std::vector<int> &stencil, const Vec2i &pos, int w, int h, int y, int *minx, int *maxx)
+{
+	const int range = stencil.size() - 1;
+
+	if (y < pos.y - range || y >= pos.y + h + range) {
+		return false;
+	}
+	const int offsetx = GetSightOffset(stencil, h, y - pos.y);
+
+	*minx = std::max(0, pos.x - offsetx);
+	*maxx = std::min(Map.Info.MapWidth, pos.x + w + offsetx);
+	return true;
+}
+
+/**
+**  Mark the rows of the sight of a unit at a place which it hadn't at
+**  another place.
+*/
+template <typename T>
+static void MapSightDeltaRows(const CPlayer &player, const Vec2i &from, const Vec2i &to, int w, int h, int range, const T &marker)
 {
 	// Units under construction have no sight range.
 	if (!range) {
 		return;
 	}
-	// Up hemi-cyle
-	const int miny = std::max(-range, 0 - pos.y);
-	for (int offsety = miny; offsety != 0; ++offsety) {
-		const int offsetx = isqrt(square(range + 1) - square(-offsety) - 1);
-		const int minx = std::max(0, pos.x - offsetx);
-		const int maxx = std::min(Map.Info.MapWidth, pos.x + w + offsetx);
-		Vec2i mpos(minx, pos.y + offsety);
-#ifdef MARKER_ON_INDEX
-		const unsigned int index = mpos.y * Map.Info.MapWidth;
-#endif
-
-		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
-#ifdef MARKER_ON_INDEX
-			marker(player, mpos.x + index);
-#else
-			marker(player, mpos);
-#endif
+	const std::vector<int> &stencil = GetSightStencil(range);
+	const int miny = std::max(0, to.y - range);
+	const int maxy = std::min(Map.Info.MapHeight, to.y + h + range);
+
+	for (int y = miny; y < maxy; ++y) {
+		int minx;
+		int maxx;
+		int oldMinx;
+		int oldMaxx;
+
+		GetSightSpan(stencil, to, w, h, y, &minx, &maxx);
+		if (!GetSightSpan(stencil, from, w, h, y, &oldMinx, &oldMaxx)) {
+			oldMinx = oldMaxx = maxx;
 		}
+		// At most two parts of the row, left and right of the old one.
+		marker(player, y, minx, std::min(maxx, oldMinx));
+		marker(player, y, std::max(minx, oldMaxx), maxx);
 	}
-	for (int offsety = 0; offsety < h; ++offsety) {
-		const int minx = std::max(0, pos.x - range);
-		const int maxx = std::min(Map.Info.MapWidth, pos.x + w + range);
-		Vec2i mpos(minx, pos.y + offsety);
-#ifdef MARKER_ON_INDEX
-		const unsigned int index = mpos.y * Map.Info.MapWidth;
-#endif
+}
 
-		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
-#ifdef MARKER_ON_INDEX
-			marker(player, mpos.x + index);
-#else
-			marker(player, mpos);
-#endif
-		}
-	}
-	// bottom hemi-cycle
-	const int maxy = std::min(range, Map.Info.MapHeight - pos.y - h);
-	for (int offsety = 0; offsety < maxy; ++offsety) {
-		const int offsetx = isqrt(square(range + 1) - square(offsety) - 1);
-		const int minx = std::max(0, pos.x - offsetx);
-		const int maxx = std::min(Map.Info.MapWidth, pos.x + w + offsetx);
-		Vec2i mpos(minx, pos.y + h + offsety);
-#ifdef MARKER_ON_INDEX
-		const unsigned int index = mpos.y * Map.Info.MapWidth;
-#endif
+/**
+**  Mark the sight of a unit at a place which it hadn't at another place.
+**
+**  Moving a unit from 'from' to 'to' is the same as unmarking with
+**  MapSightDelta(to, from) and marking with MapSightDelta(from, to),
+**  but the tiles seen from both places are not touched.
+**
+**  @param player  player to mark the sight for (not unit owner)
+**  @param from    location where the tiles were already marked
+**  @param to      location to mark
+**  @param w       width to mark, in square
+**  @param h       height to mark, in square
+**  @param range   Radius to mark.
+**  @param marker  Function to mark or unmark sight
+*/
+void MapSightDelta(const CPlayer &player, const Vec2i &from, const Vec2i &to, int w, int h, int range, MapMarkerFunc *marker)
+{
+	MapSightDeltaRows(player, from, to, w, h, range, MapTileMarker(marker));
+}
 
-		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
-#ifdef MARKER_ON_INDEX
-			marker(player, mpos.x + index);
-#else
-			marker(player, mpos);
-#endif
-		}
-	}
+/**
+**  Mark the sight of a unit at a place which it hadn't at another place,
+**  a row of tiles at once.
+**
+**  @param marker  Function to mark or unmark the spans of the sight
+*/
+void MapSightDelta(const CPlayer &player, const Vec2i &from, const Vec2i &to, int w, int h, int range, MapSpanMarkerFunc *marker)
+{
+	MapSightDeltaRows(player, from, to, w, h, range, MapSpanMarker(marker));
 }
 
 /**
@@ -382,25 +580,27 @@ void VideoDrawOnlyFog(int x, int y)
 ----------------------------------------------------------------------------*/
 
 /**
-**  Draw fog of war tile.
+**  Find the fog of war frames of a tile.
 **
-**  @param sx  Offset into fields to current tile.
-**  @param sy  Start of the current row.
-**  @param dx  X position into video memory.
-**  @param dy  Y position into video memory.
+**  @param sx     Offset into fields to current tile.
+**  @param sy     Start of the current row.
+**  @param tile   Frame of the fog at the border of the visible tiles.
+**  @param tile2  Frame of the fog at the border of the unexplored tiles.
 */
-static void DrawFogOfWarTile(int sx, int sy, int dx, int dy)
+static void GetFogOfWarTile(int sx, int sy, int &tile, int &tile2)
 {
 
 #define IsMapFieldExploredTable(index) \
-	(VisibleTable[(index)])
+	(Map.IsTileVisible(*ThisPlayer, (index)))
 #define IsMapFieldVisibleTable(index) \
-	(VisibleTable[(index)] > 1)
+	(Map.IsTileVisible(*ThisPlayer, (index)) > 1)
 
 
 	int w = Map.Info.MapWidth;
-	int tile = 0, tile2 = 0;
 	int x = sx - sy;
+
+	tile = 0;
+	tile2 = 0;
 	//int y = sy / Map.Info.MapWidth;
 
 	//
@@ -506,8 +706,26 @@ static void DrawFogOfWarTile(int sx, int sy, int dx, int dy)
 		tile = 0;
 	}
 
-	//if (IsMapFieldVisibleTable(x, y) || ReplayRevealMap) {
-	if (IsMapFieldVisibleTable(sx) || ReplayRevealMap) {
+#undef IsMapFieldExploredTable
+#undef IsMapFieldVisibleTable
+}
+
+/**
+**  Draw fog of war tile.
+**
+**  @param sx  Offset into fields to current tile.
+**  @param sy  Start of the current row.
+**  @param dx  X position into video memory.
+**  @param dy  Y position into video memory.
+*/
+static void DrawFogOfWarTile(int sx, int sy, int dx, int dy)
+{
+	int tile;
+	int tile2;
+
+	GetFogOfWarTile(sx, sy, tile, tile2);
+
+	if (Map.IsTileVisible(*ThisPlayer, sx) > 1 || ReplayRevealMap) {
 		if (tile && tile != tile2) {
 			if (UseOpenGL) {
 				Map.FogGraphic->DrawFrameClipTrans(tile, dx, dy, FogOfWarOpacity);
@@ -521,46 +739,428 @@ static void DrawFogOfWarTile(int sx, int sy, int dx, int dy)
 	if (tile2) {
 		Map.FogGraphic->DrawFrameClip(tile2, dx, dy);
 	}
+}
 
-#undef IsMapFieldExploredTable
-#undef IsMapFieldVisibleTable
+/**
+**  Read a pixel of a surface, as it is blitted on the screen.
+**
+**  @param surface  Locked surface to read.
+**  @param x        X position in the surface.
+**  @param y        Y position in the surface.
+**  @param a        Alpha of the pixel, 0 if it is transparent.
+*/
+static void GetBlitPixel(const SDL_Surface *surface, int x, int y, Uint8 &r, Uint8 &g, Uint8 &b, Uint8 &a)
+{
+	const int bpp = surface->format->BytesPerPixel;
+	const Uint8 *p = reinterpret_cast<const Uint8 *>(surface->pixels) + y * surface->pitch + x * bpp;
+	Uint32 pixel;
+
+	switch (bpp) {
+		case 1:
+			pixel = *p;
+			break;
+		case 2:
+			pixel = *reinterpret_cast<const Uint16 *>(p);
+			break;
+		case 3:
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+			pixel = p[0] << 16 | p[1] << 8 | p[2];
+#else
+			pixel = p[0] | p[1] << 8 | p[2] << 16;
+#endif
+			break;
+		default:
+			pixel = *reinterpret_cast<const Uint32 *>(p);
+			break;
+	}
+	if ((surface->flags & SDL_SRCCOLORKEY) && pixel == surface->format->colorkey) {
+		a = 0;
+		return;
+	}
+	SDL_GetRGBA(pixel, surface->format, &r, &g, &b, &a);
+	if (!(surface->flags & SDL_SRCALPHA)) {
+		a = 255;
+	} else if (!surface->format->Amask) {
+		a = surface->format->alpha;
+	}
 }
 
 /**
-**  Draw the map fog of war.
+**  Blend a tile of a surface over a tile of the fog of war atlas.
+**
+**  Drawing the result is the same as drawing the atlas tile, then
+**  the surface tile. SDL blits keep the alpha of the destination, so
+**  this is done pixel by pixel, once for each tile of the atlas.
+**
+**  @param layer    Locked atlas.
+**  @param lx       X pixel position of the tile in the atlas.
+**  @param ly       Y pixel position of the tile in the atlas.
+**  @param surface  Surface to blend.
+**  @param sx       X pixel position of the tile in the surface.
+**  @param sy       Y pixel position of the tile in the surface.
 */
-void CViewport::DrawMapFogOfWar() const
+static void BlendFogOfWarTile(SDL_Surface *layer, int lx, int ly, SDL_Surface *surface, int sx, int sy)
 {
-	// flags must redraw or not
-	if (ReplayRevealMap) {
+	SDL_LockSurface(surface);
+	for (int y = 0; y < PixelTileSize.y; ++y) {
+		Uint32 *dst = reinterpret_cast<Uint32 *>(reinterpret_cast<Uint8 *>(layer->pixels) + (ly + y) * layer->pitch) + lx;
+
+		for (int x = 0; x < PixelTileSize.x; ++x, ++dst) {
+			Uint8 r, g, b, a;
+
+			GetBlitPixel(surface, sx + x, sy + y, r, g, b, a);
+			if (a == 0) {
+				continue;
+			}
+			Uint8 dr, dg, db, da;
+			SDL_GetRGBA(*dst, layer->format, &dr, &dg, &db, &da);
+
+			// "over" operator, with straight alpha
+			const int outa = a * 255 + da * (255 - a);
+			r = (r * a * 255 + dr * da * (255 - a)) / outa;
+			g = (g * a * 255 + dg * da * (255 - a)) / outa;
+			b = (b * a * 255 + db * da * (255 - a)) / outa;
+			*dst = SDL_MapRGBA(layer->format, r, g, b, (outa + 127) / 255);
+		}
+	}
+	SDL_UnlockSurface(surface);
+}
+
+/**
+**  Get a tile of the fog of war atlas, composed if it isn't yet.
+**
+**  @param row    Frame of the alpha fog, 0 for none, or FogOfWarAtlasOnlyFogRow.
+**  @param tile2  Frame of the fog, 0 for none.
+**
+**  @return       Rectangle of the tile in the atlas.
+*/
+static SDL_Rect GetFogOfWarAtlasTile(int row, int tile2)
+{
+	if (!FogOfWarAtlas) {
+		FogOfWarAtlas = SDL_CreateRGBSurface(SDL_SWSURFACE, FogOfWarAtlasColumns * PixelTileSize.x,
+											 (FogOfWarAtlasOnlyFogRow + 1) * PixelTileSize.y,
+											 32, RMASK, GMASK, BMASK, AMASK);
+		// Blits of the atlas copy its alpha instead of blending with it.
+		SDL_SetAlpha(FogOfWarAtlas, 0, 0);
+		FogOfWarAtlasComposed.assign(FogOfWarAtlasColumns * (FogOfWarAtlasOnlyFogRow + 1), 0);
+	}
+	SDL_Rect rect = {Sint16(tile2 * PixelTileSize.x), Sint16(row * PixelTileSize.y),
+					 Uint16(PixelTileSize.x), Uint16(PixelTileSize.y)
+					};
+	char &composed = FogOfWarAtlasComposed[row * FogOfWarAtlasColumns + tile2];
+
+	if (!composed) {
+		SDL_FillRect(FogOfWarAtlas, &rect, SDL_MapRGBA(FogOfWarAtlas->format, 0, 0, 0, 0));
+		SDL_LockSurface(FogOfWarAtlas);
+		if (row == FogOfWarAtlasOnlyFogRow) {
+			BlendFogOfWarTile(FogOfWarAtlas, rect.x, rect.y, OnlyFogSurface, 0, 0);
+		} else if (row) {
+			BlendFogOfWarTile(FogOfWarAtlas, rect.x, rect.y, AlphaFogG->Surface,
+							  AlphaFogG->frame_map[row].x, AlphaFogG->frame_map[row].y);
+		}
+		if (tile2) {
+			BlendFogOfWarTile(FogOfWarAtlas, rect.x, rect.y, Map.FogGraphic->Surface,
+							  Map.FogGraphic->frame_map[tile2].x, Map.FogGraphic->frame_map[tile2].y);
+		}
+		SDL_UnlockSurface(FogOfWarAtlas);
+		composed = 1;
+	}
+	return rect;
+}
+
+/**
+**  Compose the fog of war of a tile in a layer.
+**
+**  @param layer  Unlocked layer.
+**  @param lx     X pixel position of the tile in the layer.
+**  @param ly     Y pixel position of the tile in the layer.
+**  @param sx     Offset into fields to current tile.
+**  @param sy     Start of the current row.
+**
+**  @return       true if there is fog to draw on the tile.
+*/
+static bool ComposeFogOfWarTile(SDL_Surface *layer, int lx, int ly, int sx, int sy)
+{
+	SDL_Rect rect = {Sint16(lx), Sint16(ly), Uint16(PixelTileSize.x), Uint16(PixelTileSize.y)};
+
+	if (!Map.IsTileVisible(*ThisPlayer, sx)) {
+		Uint8 r, g, b;
+
+		SDL_GetRGB(FogOfWarColorSDL, TheScreen->format, &r, &g, &b);
+		SDL_FillRect(layer, &rect, SDL_MapRGBA(layer->format, r, g, b, 255));
+		return true;
+	}
+	int tile;
+	int tile2;
+	int row;
+
+	GetFogOfWarTile(sx, sy, tile, tile2);
+	if (Map.IsTileVisible(*ThisPlayer, sx) > 1) {
+		row = tile != tile2 ? tile : 0;
+	} else {
+		row = FogOfWarAtlasOnlyFogRow;
+	}
+	if (!row && !tile2) {
+		SDL_FillRect(layer, &rect, SDL_MapRGBA(layer->format, 0, 0, 0, 0));
+		return false;
+	}
+	SDL_Rect srect = GetFogOfWarAtlasTile(row, tile2);
+	SDL_BlitSurface(FogOfWarAtlas, &srect, layer, &rect);
+	return true;
+}
+
+/**
+**  Free the fog of war layers and the composed tiles.
+*/
+static void FreeFogOfWarLayers()
+{
+	for (size_t i = 0; i != FogOfWarLayers.size(); ++i) {
+		VideoPaletteListRemove(FogOfWarLayers[i].Surface);
+		SDL_FreeSurface(FogOfWarLayers[i].Surface);
+	}
+	FogOfWarLayers.clear();
+	if (FogOfWarAtlas) {
+		VideoPaletteListRemove(FogOfWarAtlas);
+		SDL_FreeSurface(FogOfWarAtlas);
+		FogOfWarAtlas = NULL;
+	}
+	FogOfWarAtlasComposed.clear();
+}
+
+/**
+**  Get the fog of war layer of a viewport, (re)made to its size.
+**
+**  @param vp  Viewport to draw.
+*/
+static FogOfWarLayer &GetFogOfWarLayer(const CViewport &vp)
+{
+	// One more tile for the offset into the top left tile.
+	const int width = (vp.BottomRightPos.x - vp.TopLeftPos.x) / PixelTileSize.x + 2;
+	const int height = (vp.BottomRightPos.y - vp.TopLeftPos.y) / PixelTileSize.y + 2;
+	size_t i = 0;
+
+	while (i != FogOfWarLayers.size() && FogOfWarLayers[i].Viewport != &vp) {
+		++i;
+	}
+	if (i == FogOfWarLayers.size()) {
+		FogOfWarLayers.push_back(FogOfWarLayer());
+		FogOfWarLayers.back().Viewport = &vp;
+		FogOfWarLayers.back().Surface = NULL;
+	}
+	FogOfWarLayer &layer = FogOfWarLayers[i];
+
+	if (layer.Surface && layer.Width == width && layer.Height == height) {
+		return layer;
+	}
+	if (layer.Surface) {
+		VideoPaletteListRemove(layer.Surface);
+		SDL_FreeSurface(layer.Surface);
+	}
+	layer.Width = width;
+	layer.Height = height;
+	layer.Surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width * PixelTileSize.x, height * PixelTileSize.y,
+										 32, RMASK, GMASK, BMASK, AMASK);
+	SDL_SetAlpha(layer.Surface, SDL_SRCALPHA, 0);
+	layer.Dirty.assign(width * height, 1);
+	layer.Fogged.assign(width * height, 0);
+	return layer;
+}
+
+/**
+**  Draw a run of tiles of a fog of war layer.
+**
+**  @param layer  Layer to draw.
+**  @param lx     X pixel position in the layer.
+**  @param ly     Y pixel position in the layer.
+**  @param w      Width to draw.
+**  @param h      Height to draw.
+**  @param x      X position into video memory.
+**  @param y      Y position into video memory.
+*/
+static void DrawFogOfWarLayerRun(SDL_Surface *layer, int lx, int ly, int w, int h, int x, int y)
+{
+	const int oldx = x;
+	const int oldy = y;
+
+	CLIP_RECTANGLE(x, y, w, h);
+
+	SDL_Rect srect = {Sint16(lx + x - oldx), Sint16(ly + y - oldy), Uint16(w), Uint16(h)};
+	SDL_Rect drect = {Sint16(x), Sint16(y), 0, 0};
+
+	SDL_BlitSurface(layer, &srect, TheScreen, &drect);
+}
+
+/**
+**  Move a fog of war layer to another top left map tile.
+**
+**  The tiles still in view are moved in the layer with their flags,
+**  only the tiles coming into view are marked to compose.
+**
+**  @param layer   Layer to move.
+**  @param mapPos  New top left map tile.
+*/
+static void ScrollFogOfWarLayer(FogOfWarLayer &layer, const Vec2i &mapPos)
+{
+	const Vec2i delta = mapPos - layer.MapPos;
+
+	layer.MapPos = mapPos;
+	if (abs(delta.x) >= layer.Width || abs(delta.y) >= layer.Height) {
+		std::fill(layer.Dirty.begin(), layer.Dirty.end(), 1);
 		return;
 	}
+	const int bpp = layer.Surface->format->BytesPerPixel;
+	const int pitch = layer.Surface->pitch;
+	// Tiles kept in each row, where they are read and where they go.
+	const int count = layer.Width - abs(delta.x);
+	const int fromx = std::max<int>(delta.x, 0);
+	const int tox = std::max<int>(-delta.x, 0);
+	// Tiles coming into view in each kept row.
+	const int newx = delta.x > 0 ? count : 0;
+
+	SDL_LockSurface(layer.Surface);
+	Uint8 *pixels = reinterpret_cast<Uint8 *>(layer.Surface->pixels);
+	// Go against the move, so rows are read before being written.
+	for (int i = 0; i != layer.Height; ++i) {
+		const int ly = delta.y > 0 ? i : layer.Height - 1 - i;
+		const int fromy = ly + delta.y;
+		char *dirty = &layer.Dirty[ly * layer.Width];
+
+		if (fromy < 0 || fromy >= layer.Height) {
+			std::fill(dirty, dirty + layer.Width, 1);
+			continue;
+		}
+		memmove(dirty + tox, &layer.Dirty[fromy * layer.Width + fromx], count);
+		memmove(&layer.Fogged[ly * layer.Width + tox], &layer.Fogged[fromy * layer.Width + fromx], count);
+		std::fill(dirty + newx, dirty + newx + abs(delta.x), 1);
+		for (int y = 0; y != PixelTileSize.y; ++y) {
+			memmove(pixels + (ly * PixelTileSize.y + y) * pitch + tox * PixelTileSize.x * bpp,
+					pixels + (fromy * PixelTileSize.y + y) * pitch + fromx * PixelTileSize.x * bpp,
+					count * PixelTileSize.x * bpp);
+		}
+	}
+	SDL_UnlockSurface(layer.Surface);
+}
 
-	int sx = std::max<int>(MapPos.x - 1, 0);
-	int ex = std::min<int>(MapPos.x + MapWidth + 1, Map.Info.MapWidth);
-	int my = std::max<int>(MapPos.y - 1, 0);
-	int ey = std::min<int>(MapPos.y + MapHeight + 1, Map.Info.MapHeight);
+/**
+**  Draw the fog of war of a viewport with its layer.
+**
+**  Only the tiles whose fog has changed since the last frame, or which
+**  have come into view, are composed again.
+**
+**  @param vp  Viewport to draw.
+*/
+static void DrawFogOfWarLayer(const CViewport &vp)
+{
+	FogOfWarLayer &layer = GetFogOfWarLayer(vp);
+
+	if (layer.Player != ThisPlayer->Index || layer.NoFogOfWar != Map.NoFogOfWar) {
+		layer.MapPos = vp.MapPos;
+		layer.Player = ThisPlayer->Index;
+		layer.NoFogOfWar = Map.NoFogOfWar;
+		std::fill(layer.Dirty.begin(), layer.Dirty.end(), 1);
+	} else if (layer.MapPos != vp.MapPos) {
+		ScrollFogOfWarLayer(layer, vp.MapPos);
+	}
+	const int width = std::min(layer.Width, Map.Info.MapWidth - vp.MapPos.x);
+	const int height = std::min(layer.Height, Map.Info.MapHeight - vp.MapPos.y);
+
+	for (int ly = 0; ly < height; ++ly) {
+		const int sy = (vp.MapPos.y + ly) * Map.Info.MapWidth;
 
-	// Update for visibility all tile in viewport
-	// and 1 tile around viewport (for fog-of-war connection display)
+		for (int lx = 0; lx < width; ++lx) {
+			const int i = lx + ly * layer.Width;
 
-	unsigned int my_index = my * Map.Info.MapWidth;
-	for (; my < ey; ++my) {
-		for (int mx = sx; mx < ex; ++mx) {
-			VisibleTable[my_index + mx] = Map.IsTileVisible(*ThisPlayer, mx + my_index);
+			if (layer.Dirty[i]) {
+				layer.Fogged[i] = ComposeFogOfWarTile(layer.Surface, lx * PixelTileSize.x, ly * PixelTileSize.y,
+													  vp.MapPos.x + lx + sy, sy);
+				layer.Dirty[i] = 0;
+			}
 		}
-		my_index += Map.Info.MapWidth;
 	}
-	ex = this->BottomRightPos.x;
+
+	const int dx = vp.TopLeftPos.x - vp.Offset.x;
+	int dy = vp.TopLeftPos.y - vp.Offset.y;
+
+	for (int ly = 0; ly < height && dy <= vp.BottomRightPos.y; ++ly, dy += PixelTileSize.y) {
+		const char *fogged = &layer.Fogged[ly * layer.Width];
+
+		for (int lx = 0; lx < width;) {
+			if (!fogged[lx]) {
+				++lx;
+				continue;
+			}
+			const int start = lx;
+
+			while (lx < width && fogged[lx]) {
+				++lx;
+			}
+			DrawFogOfWarLayerRun(layer.Surface, start * PixelTileSize.x, ly * PixelTileSize.y,
+								 (lx - start) * PixelTileSize.x, PixelTileSize.y,
+								 dx + start * PixelTileSize.x, dy);
+		}
+	}
+}
+
+/**
+**  The fog of war of a tile has changed, compose it and the tiles
+**  around it again.
+**
+**  @param index  flat index of the tile.
+*/
+void FogOfWarTileChanged(unsigned int index)
+{
+	const int x = index % Map.Info.MapWidth;
+	const int y = index / Map.Info.MapWidth;
+
+	for (size_t i = 0; i != FogOfWarLayers.size(); ++i) {
+		FogOfWarLayer &layer = FogOfWarLayers[i];
+		const int minx = std::max(x - 1 - layer.MapPos.x, 0);
+		const int maxx = std::min(x + 1 - layer.MapPos.x, layer.Width - 1);
+		const int miny = std::max(y - 1 - layer.MapPos.y, 0);
+		const int maxy = std::min(y + 1 - layer.MapPos.y, layer.Height - 1);
+
+		for (int ly = miny; ly <= maxy; ++ly) {
+			for (int lx = minx; lx <= maxx; ++lx) {
+				layer.Dirty[lx + ly * layer.Width] = 1;
+			}
+		}
+	}
+}
+
+/**
+**  The fog of war of the whole map has changed, compose it again.
+*/
+void FogOfWarChanged()
+{
+	for (size_t i = 0; i != FogOfWarLayers.size(); ++i) {
+		std::fill(FogOfWarLayers[i].Dirty.begin(), FogOfWarLayers[i].Dirty.end(), 1);
+	}
+}
+
+/**
+**  Draw the map fog of war.
+*/
+void CViewport::DrawMapFogOfWar() const
+{
+	// flags must redraw or not
+	if (ReplayRevealMap) {
+		return;
+	}
+	if (!UseOpenGL) {
+		DrawFogOfWarLayer(*this);
+		return;
+	}
+
+	int ex = this->BottomRightPos.x;
 	int sy = MapPos.y * Map.Info.MapWidth;
 	int dy = this->TopLeftPos.y - Offset.y;
-	ey = this->BottomRightPos.y;
+	int ey = this->BottomRightPos.y;
 
 	while (dy <= ey) {
-		sx = MapPos.x + sy;
+		int sx = MapPos.x + sy;
 		int dx = this->TopLeftPos.x - Offset.x;
 		while (dx <= ex) {
-			if (VisibleTable[sx]) {
+			if (Map.IsTileVisible(*ThisPlayer, sx)) {
 				DrawFogOfWarTile(sx, sy, dx, dy);
 			} else {
 				Video.FillRectangleClip(FogOfWarColorSDL, dx, dy, PixelTileSize.x, PixelTileSize.y);
@@ -598,8 +1198,9 @@ void CMap::InitFogOfWar()
 		Uint32 color = Video.MapRGB(s->format, r, g, b);
 
 		SDL_FillRect(s, NULL, color);
+		// Not RLE, it is only read, locked, to compose the fog atlas.
 		OnlyFogSurface = SDL_DisplayFormat(s);
-		SDL_SetAlpha(OnlyFogSurface, SDL_SRCALPHA | SDL_RLEACCEL, FogOfWarOpacity);
+		SDL_SetAlpha(OnlyFogSurface, SDL_SRCALPHA, FogOfWarOpacity);
 		VideoPaletteListRemove(s);
 		SDL_FreeSurface(s);
 
@@ -608,7 +1209,7 @@ void CMap::InitFogOfWar()
 		//
 		if (FogGraphic->Surface->format->BytesPerPixel == 1) {
 			s = SDL_DisplayFormat(FogGraphic->Surface);
-			SDL_SetAlpha(s, SDL_SRCALPHA | SDL_RLEACCEL, FogOfWarOpacity);
+			SDL_SetAlpha(s, SDL_SRCALPHA, FogOfWarOpacity);
 		} else {
 			// Copy the top row to a new surface
 			SDL_PixelFormat *f = FogGraphic->Surface->format;
@@ -651,8 +1252,8 @@ void CMap::InitFogOfWar()
 		AlphaFogG->UseDisplayFormat();
 	}
 
-	delete[] VisibleTable;
-	VisibleTable = new unsigned short[Info.MapWidth * Info.MapHeight];
+	// The fog graphics may have changed, compose the layers again.
+	FreeFogOfWarLayers();
 }
 
 /**
@@ -660,8 +1261,7 @@ void CMap::InitFogOfWar()
 */
 void CMap::CleanFogOfWar()
 {
-	delete[] VisibleTable;
-	VisibleTable = NULL;
+	FreeFogOfWarLayers();
 
 	CGraphic::Free(Map.FogGraphic);
 	FogGraphic = NULL;
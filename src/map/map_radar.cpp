@@ -46,50 +46,61 @@
 --  Functions
 ----------------------------------------------------------------------------*/
 
-static inline unsigned char
-IsTileRadarVisible(const CPlayer &pradar, const CPlayer &punit, const CMapField &mf)
+/**
+**  Get the players whose radar a player sees with.
+**
+**  @return  A bit for each player.
+*/
+static unsigned int GetRadarPlayers(const CPlayer &pradar)
 {
-	if (mf.RadarJammer[punit.Index]) {
-		return 0;
+	unsigned int players = 1 << pradar.Index;
+
+	if (pradar.IsVisionSharing()) {
+		for (int i = 0; i < PlayerMax; ++i) {
+			if (i != pradar.Index && pradar.IsBothSharedVision(Players[i])) {
+				players |= 1 << i;
+			}
+		}
 	}
+	return players;
+}
+
+/**
+**  Get the players whose jammers hide the units of a player from the
+**  radar of another one.
+**
+**  @return  A bit for each player.
+*/
+static unsigned int GetRadarJammerPlayers(const CPlayer &pradar, const CPlayer &punit)
+{
+	unsigned int players = 1 << punit.Index;
 
-	int p = pradar.Index;
 	if (pradar.IsVisionSharing()) {
-		const unsigned char *const radar = mf.Radar;
-		const unsigned char *const jamming = mf.RadarJammer;
-		unsigned char radarvision = 0;
-		// Check jamming first, if we are jammed, exit
 		for (int i = 0; i < PlayerMax; ++i) {
-			if (i != p) {
-				if (jamming[i] > 0 && punit.IsBothSharedVision(Players[i])) {
-					// We are jammed, return nothing
-					return 0;
-				}
-				if (radar[i] > 0 && pradar.IsBothSharedVision(Players[i])) {
-					radarvision |= radar[i];
-				}
+			if (i != pradar.Index && punit.IsBothSharedVision(Players[i])) {
+				players |= 1 << i;
 			}
 		}
-		// Can't exit until the end, as we might be jammed
-		return (radarvision | mf.Radar[p]);
 	}
-	return mf.Radar[p];
+	return players;
 }
 
 
 bool CUnit::IsVisibleOnRadar(const CPlayer &pradar) const
 {
+	const unsigned int radar = GetRadarPlayers(pradar);
+	const unsigned int jammer = GetRadarJammerPlayers(pradar, *Player);
 	const int x_max = Type->TileWidth;
 	unsigned int index = Offset;
 	int j = Type->TileHeight;
 	do {
-		const CMapField *mf = Map.Field(index);
+		unsigned int tile = index;
 		int i = x_max;
 		do {
-			if (IsTileRadarVisible(pradar, *Player, *mf) != 0) {
+			if ((Map.RadarPlayers[tile] & radar) && !(Map.RadarJammerPlayers[tile] & jammer)) {
 				return true;
 			}
-			++mf;
+			++tile;
 		} while (--i);
 		index += Map.Info.MapWidth;
 	} while (--j);
@@ -99,6 +110,87 @@ bool CUnit::IsVisibleOnRadar(const CPlayer &pradar) const
 }
 
 
+/**
+**  Mark Radar Vision for a span of tiles
+**
+**  @param player  The player you are marking for
+**  @param index   First tile to mark.
+**  @param end     After the last tile to mark.
+*/
+void MapMarkRadarSpan(const CPlayer &player, unsigned int index, unsigned int end)
+{
+	unsigned char *v = Map.Radar[player.Index];
+	const unsigned int bit = 1 << player.Index;
+
+	for (; index != end; ++index) {
+		Assert(v[index] != 255);
+		if (v[index]++ == 0) {
+			Map.RadarPlayers[index] |= bit;
+		}
+	}
+}
+
+/**
+**  Unmark Radar Vision for a span of tiles
+**
+**  @param player  The player you are marking for
+**  @param index   First tile to unmark.
+**  @param end     After the last tile to unmark.
+*/
+void MapUnmarkRadarSpan(const CPlayer &player, unsigned int index, unsigned int end)
+{
+	unsigned char *v = Map.Radar[player.Index];
+	const unsigned int bit = 1 << player.Index;
+
+	for (; index != end; ++index) {
+		// Reduce radar coverage if it exists.
+		if (v[index] && --v[index] == 0) {
+			Map.RadarPlayers[index] &= ~bit;
+		}
+	}
+}
+
+/**
+**  Mark Radar Jamming Vision for a span of tiles
+**
+**  @param player  The player you are marking for
+**  @param index   First tile to mark.
+**  @param end     After the last tile to mark.
+*/
+void MapMarkRadarJammerSpan(const CPlayer &player, unsigned int index, unsigned int end)
+{
+	unsigned char *v = Map.RadarJammer[player.Index];
+	const unsigned int bit = 1 << player.Index;
+
+	for (; index != end; ++index) {
+		Assert(v[index] != 255);
+		if (v[index]++ == 0) {
+			Map.RadarJammerPlayers[index] |= bit;
+		}
+	}
+}
+
+/**
+**  Unmark Radar Jamming Vision for a span of tiles
+**
+**  @param player  The player you are marking for
+**  @param index   First tile to unmark.
+**  @param end     After the last tile to unmark.
+*/
+void MapUnmarkRadarJammerSpan(const CPlayer &player, unsigned int index, unsigned int end)
+{
+	unsigned char *v = Map.RadarJammer[player.Index];
+	const unsigned int bit = 1 << player.Index;
+
+	for (; index != end; ++index) {
+		// Reduce radar jamming if it exists.
+		if (v[index] && --v[index] == 0) {
+			Map.RadarJammerPlayers[index] &= ~bit;
+		}
+	}
+}
+
+
 /**
 **  Mark Radar Vision for a tile
 **
@@ -108,8 +200,7 @@ bool CUnit::IsVisibleOnRadar(const CPlayer &pradar) const
 */
 void MapMarkTileRadar(const CPlayer &player, const unsigned int index)
 {
-	Assert(Map.Field(index)->Radar[player.Index] != 255);
-	Map.Field(index)->Radar[player.Index]++;
+	MapMarkRadarSpan(player, index, index + 1);
 }
 
 void MapMarkTileRadar(const CPlayer &player, int x, int y)
@@ -128,11 +219,7 @@ void MapMarkTileRadar(const CPlayer &player, int x, int y)
 */
 void MapUnmarkTileRadar(const CPlayer &player, const unsigned int index)
 {
-	// Reduce radar coverage if it exists.
-	unsigned char *v = &(Map.Field(index)->Radar[player.Index]);
-	if (*v) {
-		--*v;
-	}
+	MapUnmarkRadarSpan(player, index, index + 1);
 }
 
 void MapUnmarkTileRadar(const CPlayer &player, int x, int y)
@@ -151,8 +238,7 @@ void MapUnmarkTileRadar(const CPlayer &player, int x, int y)
 */
 void MapMarkTileRadarJammer(const CPlayer &player, const unsigned int index)
 {
-	Assert(Map.Field(index)->RadarJammer[player.Index] != 255);
-	Map.Field(index)->RadarJammer[player.Index]++;
+	MapMarkRadarJammerSpan(player, index, index + 1);
 }
 
 void MapMarkTileRadarJammer(const CPlayer &player, int x, int y)
@@ -170,11 +256,7 @@ void MapMarkTileRadarJammer(const CPlayer &player, int x, int y)
 */
 void MapUnmarkTileRadarJammer(const CPlayer &player, const unsigned int index)
 {
-	// Reduce radar coverage if it exists.
-	unsigned char *v = &(Map.Field(index)->RadarJammer[player.Index]);
-	if (*v) {
-		--*v;
-	}
+	MapUnmarkRadarJammerSpan(player, index, index + 1);
 }
 
 void MapUnmarkTileRadarJammer(const CPlayer &player, int x, int y)
@@ -77,9 +77,9 @@ void CMap::Save(CFile &file) const
 		for (int w = 0; w < this->Info.MapWidth; ++w) {
 			const CMapField &mf = *this->Field(w, h);
 
-			file.printf("  {%3d, %3d, %2d, %2d,", mf.Tile, mf.SeenTile, mf.Value, mf.Cost);
+			file.printf("  {%3d, %3d, %2d, %2d,", mf.Tile, mf.SeenTile, this->GetFieldValue(this->getIndex(w, h)), mf.Cost);
 			for (int i = 0; i < PlayerMax; ++i) {
-				if (mf.Visible[i] == 1) {
+				if (this->Visible[i][this->getIndex(w, h)] == 1) {
 					file.printf(" \"explored\", %d,", i);
 				}
 			}
@@ -37,6 +37,7 @@
 
 #include "stratagus.h"
 #include "map.h"
+#include "pathfinder.h"
 #include "tileset.h"
 #include "ui.h"
 #include "player.h"
@@ -152,6 +153,7 @@ void MapFixSeenWallTile(const Vec2i &pos)
 
 	if (mf->SeenTile != tile) { // Already there!
 		mf->SeenTile = tile;
+		MapBackgroundTileChanged(Map.getIndex(pos));
 
 		// FIXME: can this only happen if seen?
 		if (Map.IsFieldVisible(*ThisPlayer, pos)) {
@@ -280,6 +282,7 @@ void CMap::RemoveWall(const Vec2i &pos)
 	mf->Value = 0;
 	// FIXME: support more walls of different races.
 	mf->Flags &= ~(MapFieldHuman | MapFieldWall | MapFieldUnpassable);
+	PathfinderTilesChanged(pos, 1, 1);
 
 	UI.Minimap.UpdateXY(pos);
 	MapFixWallTile(pos);
@@ -315,6 +318,7 @@ void CMap::SetWall(const Vec2i &pos, int humanwall)
 		mf->Flags |= MapFieldWall | MapFieldUnpassable;
 		mf->Value = UnitTypeOrcWall->DefaultStat.Variables[HP_INDEX].Max;
 	}
+	PathfinderTilesChanged(pos, 1, 1);
 
 	UI.Minimap.UpdateXY(pos);
 	MapFixWallTile(pos);
@@ -48,11 +48,13 @@
 #include "unittype.h"
 #include "video.h"
 
+#include <algorithm>
+
 /*----------------------------------------------------------------------------
 --  Defines
 ----------------------------------------------------------------------------*/
 
-#define MINIMAP_FAC (16 * 3)  /// integer scale factor
+#define MINIMAP_FAC (16 * 3 * 16)  /// integer scale factor
 
 /// unit attacked are shown red for at least this amount of cycles
 #define ATTACK_RED_DURATION (1 * CYCLES_PER_SECOND)
@@ -81,8 +83,8 @@ static int Map2MinimapX[MaxMapWidth];      /// fast conversion table
 static int Map2MinimapY[MaxMapHeight];     /// fast conversion table
 
 // MinimapScale:
-// 32x32 64x64 96x96 128x128 256x256 512x512 ...
-// *4 *2 *4/3   *1 *1/2 *1/4
+// 32x32 64x64 96x96 128x128 256x256 512x512 1024x1024 ...
+// *4 *2 *4/3   *1 *1/2 *1/4 *1/8
 static int MinimapScaleX;                  /// Minimap scale to fit into window
 static int MinimapScaleY;                  /// Minimap scale to fit into window
 
@@ -95,6 +97,43 @@ struct MinimapEvent {
 } MinimapEvents[MAX_MINIMAP_EVENTS];
 int NumMinimapEvents;
 
+/**
+**  Area of the minimap, in pixels.
+*/
+struct MinimapArea {
+	int X;
+	int Y;
+	int W;
+	int H;
+};
+
+/**
+**  Dot of a unit on the minimap.
+*/
+struct MinimapUnitDot {
+	bool operator != (const MinimapUnitDot &rhs) const {
+		return Area.X != rhs.Area.X || Area.Y != rhs.Area.Y || Area.W != rhs.Area.W
+			   || Area.H != rhs.Area.H || Color != rhs.Color;
+	}
+
+	MinimapArea Area;  /// Pixels of the dot
+	Uint32 Color;      /// Color of the dot
+};
+
+static std::vector<char> MinimapDirty;              /// Pixels to draw again
+static std::vector<MinimapArea> MinimapDirtyAreas;  /// Areas to draw again
+static std::vector<MinimapUnitDot> MinimapDots;     /// Unit dot drawn for each unit slot
+static std::vector<unsigned int> MinimapDotUpdates; /// Last update which saw each unit slot
+static std::vector<int> MinimapDotSlots;            /// Unit slots with a dot, in drawing order
+static unsigned int MinimapUpdateCount;             /// Number of the current update
+static bool MinimapFullUpdate;                      /// Draw the whole minimap again
+
+/// State the minimap was last drawn with, a change draws it all again
+static int MinimapDrawnPlayer;
+static bool MinimapDrawnReveal;
+static bool MinimapDrawnNoFogOfWar;
+static bool MinimapDrawnWithTerrain;
+
 
 /*----------------------------------------------------------------------------
 -- Functions
@@ -130,6 +169,13 @@ void CMinimap::Create()
 
 	MinimapScaleX = (W * MINIMAP_FAC + n - 1) / n;
 	MinimapScaleY = (H * MINIMAP_FAC + n - 1) / n;
+	// Rounded up, a big map may not fit in the minimap anymore.
+	if ((n * MinimapScaleX) / MINIMAP_FAC > W) {
+		MinimapScaleX = (W * MINIMAP_FAC) / n;
+	}
+	if ((n * MinimapScaleY) / MINIMAP_FAC > H) {
+		MinimapScaleY = (H * MINIMAP_FAC) / n;
+	}
 
 	XOffset = (W - (Map.Info.MapWidth * MinimapScaleX) / MINIMAP_FAC + 1) / 2;
 	YOffset = (H - (Map.Info.MapHeight * MinimapScaleY) / MINIMAP_FAC + 1) / 2;
@@ -180,6 +226,13 @@ void CMinimap::Create()
 
 	UpdateTerrain();
 
+	MinimapDirty.assign(W * H, 0);
+	MinimapDirtyAreas.clear();
+	MinimapDots.clear();
+	MinimapDotUpdates.clear();
+	MinimapDotSlots.clear();
+	MinimapFullUpdate = true;
+
 	NumMinimapEvents = 0;
 }
 
@@ -288,6 +341,87 @@ void CMinimap::UpdateTerrain()
 	SDL_UnlockSurface(Map.TileGraphic->Surface);
 }
 
+/**
+**  Mark an area of the minimap to draw again at the next update.
+**
+**  @param x  X pixel position in the minimap.
+**  @param y  Y pixel position in the minimap.
+**  @param w  Width of the area.
+**  @param h  Height of the area.
+*/
+static void MarkMinimapArea(int x, int y, int w, int h)
+{
+	const CMinimap &minimap = UI.Minimap;
+
+	if (x < 0) {
+		w += x;
+		x = 0;
+	}
+	if (y < 0) {
+		h += y;
+		y = 0;
+	}
+	w = std::min(w, minimap.W - x);
+	h = std::min(h, minimap.H - y);
+	if (w <= 0 || h <= 0) {
+		return;
+	}
+	for (int my = y; my < y + h; ++my) {
+		std::fill_n(&MinimapDirty[x + my * minimap.W], w, 1);
+	}
+	const MinimapArea area = {x, y, w, h};
+	MinimapDirtyAreas.push_back(area);
+}
+
+/**
+**  Is a pixel of an area of the minimap to draw again?
+*/
+static bool IsMinimapAreaDirty(const MinimapArea &area)
+{
+	for (int y = area.Y; y < area.Y + area.H; ++y) {
+		const char *dirty = &MinimapDirty[area.X + y * UI.Minimap.W];
+
+		if (std::find(dirty, dirty + area.W, 1) != dirty + area.W) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+**  The vision or the seen tile of a map tile has changed, draw its
+**  pixels again at the next update.
+**
+**  @param pos  The map position to update in the minimap
+*/
+void CMinimap::UpdateSeenXY(const Vec2i &pos)
+{
+	if (MinimapDirty.empty()) {
+		return;
+	}
+	// Pixels are mapped to increasing tiles, find the ones of this tile.
+	const int *columns = Minimap2MapX + XOffset;
+	const int *columnsEnd = Minimap2MapX + W - XOffset;
+	const int *rows = Minimap2MapY + YOffset;
+	const int *rowsEnd = Minimap2MapY + H - YOffset;
+	const int row = pos.y * Map.Info.MapWidth;
+	const int x1 = std::lower_bound(columns, columnsEnd, pos.x) - Minimap2MapX;
+	const int x2 = std::upper_bound(columns, columnsEnd, pos.x) - Minimap2MapX;
+	const int y1 = std::lower_bound(rows, rowsEnd, row) - Minimap2MapY;
+	const int y2 = std::upper_bound(rows, rowsEnd, row) - Minimap2MapY;
+
+	MarkMinimapArea(x1, y1, x2 - x1, y2 - y1);
+}
+
+/**
+**  The vision of the whole map has changed, draw the whole minimap
+**  again at the next update.
+*/
+void CMinimap::Invalidate()
+{
+	MinimapFullUpdate = true;
+}
+
 /**
 **  Update a single minimap tile after a change
 **
@@ -393,12 +527,13 @@ void CMinimap::UpdateXY(const Vec2i &pos)
 		SDL_UnlockSurface(MinimapTerrainSurface);
 	}
 	SDL_UnlockSurface(Map.TileGraphic->Surface);
+	UpdateSeenXY(pos);
 }
 
 /**
-**  Draw a unit on the minimap.
+**  Get the dot of a unit on the minimap.
 */
-static void DrawUnitOn(CUnit &unit, int red_phase)
+static MinimapUnitDot GetUnitDot(const CUnit &unit, int red_phase)
 {
 	const CUnitType *type;
 
@@ -413,105 +548,120 @@ static void DrawUnitOn(CUnit &unit, int red_phase)
 		}
 	}
 
-	Uint32 color;
+	MinimapUnitDot dot;
 	if (unit.Player->Index == PlayerNumNeutral) {
-		color = Video.MapRGB(TheScreen->format,
-							 type->NeutralMinimapColorRGB.r,
-							 type->NeutralMinimapColorRGB.g,
-							 type->NeutralMinimapColorRGB.b);
+		dot.Color = Video.MapRGB(TheScreen->format,
+								 type->NeutralMinimapColorRGB.r,
+								 type->NeutralMinimapColorRGB.g,
+								 type->NeutralMinimapColorRGB.b);
 	} else if (unit.Player == ThisPlayer && !Editor.Running) {
 		if (unit.Attacked && unit.Attacked + ATTACK_BLINK_DURATION > GameCycle &&
 			(red_phase || unit.Attacked + ATTACK_RED_DURATION > GameCycle)) {
-			color = ColorRed;
+			dot.Color = ColorRed;
 		} else if (UI.Minimap.ShowSelected && unit.Selected) {
-			color = ColorWhite;
+			dot.Color = ColorWhite;
 		} else {
-			color = ColorGreen;
+			dot.Color = ColorGreen;
 		}
 	} else {
-		color = unit.Player->Color;
+		dot.Color = unit.Player->Color;
 	}
 
-	int mx = 1 + UI.Minimap.XOffset + Map2MinimapX[unit.tilePos.x];
-	int my = 1 + UI.Minimap.YOffset + Map2MinimapY[unit.tilePos.y];
+	const int mx = 1 + UI.Minimap.XOffset + Map2MinimapX[unit.tilePos.x];
+	const int my = 1 + UI.Minimap.YOffset + Map2MinimapY[unit.tilePos.y];
 	int w = Map2MinimapX[type->TileWidth];
 	if (mx + w >= UI.Minimap.W) { // clip right side
 		w = UI.Minimap.W - mx;
 	}
-	int h0 = Map2MinimapY[type->TileHeight];
-	if (my + h0 >= UI.Minimap.H) { // clip bottom side
-		h0 = UI.Minimap.H - my;
+	int h = Map2MinimapY[type->TileHeight];
+	if (my + h >= UI.Minimap.H) { // clip bottom side
+		h = UI.Minimap.H - my;
 	}
-	int bpp = 0;
-	if (!UseOpenGL) {
-		SDL_Color c;
-		bpp = MinimapSurface->format->BytesPerPixel;
-		SDL_GetRGB(color, TheScreen->format, &c.r, &c.g, &c.b);
-	}
-	while (w-- >= 0) {
-		int h = h0;
-		while (h-- >= 0) {
+	// The dot starts one pixel up left of the unit.
+	dot.Area.X = mx - 1;
+	dot.Area.Y = my - 1;
+	dot.Area.W = std::max(w + 1, 0);
+	dot.Area.H = std::max(h + 1, 0);
+	return dot;
+}
+
+/**
+**  Draw the dirty pixels of a unit dot on the minimap.
+*/
+static void DrawUnitDot(const MinimapUnitDot &dot)
+{
+	const int bpp = !UseOpenGL ? MinimapSurface->format->BytesPerPixel : 0;
+
+	for (int y = dot.Area.Y; y < dot.Area.Y + dot.Area.H; ++y) {
+		for (int x = dot.Area.X; x < dot.Area.X + dot.Area.W; ++x) {
+			if (!MinimapDirty[x + y * UI.Minimap.W]) {
+				continue;
+			}
 			if (!UseOpenGL) {
-				const unsigned int index = (mx + w) * bpp + (my + h) * MinimapSurface->pitch;
+				const unsigned int index = x * bpp + y * MinimapSurface->pitch;
 				if (bpp == 2) {
-					*(Uint16 *)&((Uint8 *)MinimapSurface->pixels)[index] = color;
+					*(Uint16 *)&((Uint8 *)MinimapSurface->pixels)[index] = dot.Color;
 				} else {
-					*(Uint32 *)&((Uint8 *)MinimapSurface->pixels)[index] = color;
+					*(Uint32 *)&((Uint8 *)MinimapSurface->pixels)[index] = dot.Color;
 				}
 			} else {
-				*(Uint32 *)&(MinimapSurfaceGL[((mx + w) + (my + h) * MinimapTextureWidth) * 4]) = color;
+				*(Uint32 *)&(MinimapSurfaceGL[(x + y * MinimapTextureWidth) * 4]) = dot.Color;
 			}
 		}
 	}
 }
 
 /**
-**  Update the minimap with the current game information
+**  Draw the terrain of an area of the minimap, or clear it if the
+**  minimap isn't transparent.
 */
-void CMinimap::Update()
+static void DrawMinimapBackground(const MinimapArea &area)
 {
-	static int red_phase;
+	const CMinimap &minimap = UI.Minimap;
 
-	int red_phase_changed = red_phase != (int)((FrameCounter / FRAMES_PER_SECOND) & 1);
-	if (red_phase_changed) {
-		red_phase = !red_phase;
-	}
+	if (!UseOpenGL) {
+		SDL_Rect rect = {Sint16(area.X), Sint16(area.Y), Uint16(area.W), Uint16(area.H)};
 
-	// Clear Minimap background if not transparent
-	if (!Transparent) {
-		if (!UseOpenGL) {
-			SDL_FillRect(MinimapSurface, NULL, SDL_MapRGB(MinimapSurface->format, 0, 0, 0));
-		} else {
-			memset(MinimapSurfaceGL, 0, MinimapTextureWidth * MinimapTextureHeight * 4);
+		if (minimap.WithTerrain) {
+			SDL_Rect drect = rect;
+			SDL_BlitSurface(MinimapTerrainSurface, &rect, MinimapSurface, &drect);
+		} else if (!minimap.Transparent) {
+			SDL_FillRect(MinimapSurface, &rect, SDL_MapRGB(MinimapSurface->format, 0, 0, 0));
 		}
-	}
-	const int bpp = (!UseOpenGL) ? MinimapSurface->format->BytesPerPixel : 0;
+	} else {
+		for (int y = area.Y; y < area.Y + area.H; ++y) {
+			const int index = (area.X + y * MinimapTextureWidth) * 4;
 
-	//
-	// Draw the terrain
-	//
-	if (WithTerrain) {
-		if (!UseOpenGL) {
-			SDL_BlitSurface(MinimapTerrainSurface, NULL, MinimapSurface, NULL);
-		} else {
-			memcpy(MinimapSurfaceGL, MinimapTerrainSurfaceGL, MinimapTextureWidth * MinimapTextureHeight * 4);
+			if (minimap.WithTerrain) {
+				memcpy(&MinimapSurfaceGL[index], &MinimapTerrainSurfaceGL[index], area.W * 4);
+			} else if (!minimap.Transparent) {
+				memset(&MinimapSurfaceGL[index], 0, area.W * 4);
+			}
 		}
 	}
+}
 
-	if (!UseOpenGL) {
-		SDL_LockSurface(MinimapSurface);
-		SDL_LockSurface(MinimapTerrainSurface);
-	}
-
-	for (int my = 0; my < H; ++my) {
-		for (int mx = 0; mx < W; ++mx) {
+/**
+**  Draw the fog of an area of the minimap.
+*/
+static void DrawMinimapFog(const MinimapArea &area)
+{
+	const CMinimap &minimap = UI.Minimap;
+	const int bpp = (!UseOpenGL) ? MinimapSurface->format->BytesPerPixel : 0;
+	// Pixels out of the map stay black.
+	const int x1 = std::max(area.X, minimap.XOffset);
+	const int x2 = std::min(area.X + area.W, minimap.W - minimap.XOffset);
+	const int y1 = std::max(area.Y, minimap.YOffset);
+	const int y2 = std::min(area.Y + area.H, minimap.H - minimap.YOffset);
+
+	for (int my = y1; my < y2; ++my) {
+		for (int mx = x1; mx < x2; ++mx) {
 			int visiontype; // 0 unexplored, 1 explored, >1 visible.
 
 			if (ReplayRevealMap) {
 				visiontype = 2;
 			} else {
-				const Vec2i tilePos(Minimap2MapX[mx], Minimap2MapY[my] / Map.Info.MapWidth);
-				visiontype = Map.IsTileVisible(*ThisPlayer, tilePos);
+				visiontype = Map.IsTileVisible(*ThisPlayer, Minimap2MapX[mx] + Minimap2MapY[my]);
 			}
 
 			if (visiontype == 0 || (visiontype == 1 && ((mx & 1) != (my & 1)))) {
@@ -528,22 +678,110 @@ void CMinimap::Update()
 			}
 		}
 	}
-	if (!UseOpenGL) {
-		SDL_UnlockSurface(MinimapTerrainSurface);
+}
+
+/**
+**  Update the minimap with the current game information
+**
+**  Only the pixels of the tiles whose vision or terrain changed, and of
+**  the units which moved, appeared, disappeared or changed color since
+**  the last update are drawn again.
+*/
+void CMinimap::Update()
+{
+	static int red_phase;
+
+	int red_phase_changed = red_phase != (int)((FrameCounter / FRAMES_PER_SECOND) & 1);
+	if (red_phase_changed) {
+		red_phase = !red_phase;
+	}
+
+	if (MinimapFullUpdate || MinimapDrawnPlayer != ThisPlayer->Index
+		|| MinimapDrawnReveal != (ReplayRevealMap != 0) || MinimapDrawnNoFogOfWar != Map.NoFogOfWar
+		|| MinimapDrawnWithTerrain != WithTerrain) {
+		MinimapFullUpdate = false;
+		MinimapDrawnPlayer = ThisPlayer->Index;
+		MinimapDrawnReveal = ReplayRevealMap != 0;
+		MinimapDrawnNoFogOfWar = Map.NoFogOfWar;
+		MinimapDrawnWithTerrain = WithTerrain;
+		MarkMinimapArea(0, 0, W, H);
 	}
 
 	//
-	// Draw units on map
+	// Find the unit dots which changed
 	//
+	++MinimapUpdateCount;
+	std::vector<int> slots;
+	slots.reserve(MinimapDotSlots.size());
 	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
-		CUnit &unit = **it;
-		if (unit.IsVisibleOnMinimap()) {
-			DrawUnitOn(unit, red_phase);
+		const CUnit &unit = **it;
+		if (!unit.IsVisibleOnMinimap()) {
+			continue;
+		}
+		const int slot = UnitNumber(unit);
+		if (slot >= (int)MinimapDots.size()) {
+			const MinimapUnitDot noDot = {{0, 0, 0, 0}, 0};
+			MinimapDots.resize(slot + 1, noDot);
+			MinimapDotUpdates.resize(slot + 1, 0);
+		}
+		const MinimapUnitDot dot = GetUnitDot(unit, red_phase);
+		MinimapUnitDot &oldDot = MinimapDots[slot];
+
+		if (dot != oldDot) {
+			MarkMinimapArea(oldDot.Area.X, oldDot.Area.Y, oldDot.Area.W, oldDot.Area.H);
+			MarkMinimapArea(dot.Area.X, dot.Area.Y, dot.Area.W, dot.Area.H);
+			oldDot = dot;
+		}
+		MinimapDotUpdates[slot] = MinimapUpdateCount;
+		slots.push_back(slot);
+	}
+	// Units gone from the minimap since the last update.
+	for (size_t i = 0; i != MinimapDotSlots.size(); ++i) {
+		const int slot = MinimapDotSlots[i];
+
+		if (MinimapDotUpdates[slot] != MinimapUpdateCount) {
+			MinimapUnitDot &oldDot = MinimapDots[slot];
+
+			MarkMinimapArea(oldDot.Area.X, oldDot.Area.Y, oldDot.Area.W, oldDot.Area.H);
+			oldDot.Area.W = 0;
+			oldDot.Area.H = 0;
+		}
+	}
+	MinimapDotSlots.swap(slots);
+	if (MinimapDirtyAreas.empty()) {
+		return;
+	}
+
+	//
+	// Draw the terrain, the fog and the units of the dirty pixels
+	//
+	for (size_t i = 0; i != MinimapDirtyAreas.size(); ++i) {
+		DrawMinimapBackground(MinimapDirtyAreas[i]);
+	}
+	if (!UseOpenGL) {
+		SDL_LockSurface(MinimapSurface);
+	}
+	for (size_t i = 0; i != MinimapDirtyAreas.size(); ++i) {
+		DrawMinimapFog(MinimapDirtyAreas[i]);
+	}
+	for (size_t i = 0; i != MinimapDotSlots.size(); ++i) {
+		const MinimapUnitDot &dot = MinimapDots[MinimapDotSlots[i]];
+
+		if (IsMinimapAreaDirty(dot.Area)) {
+			DrawUnitDot(dot);
 		}
 	}
 	if (!UseOpenGL) {
 		SDL_UnlockSurface(MinimapSurface);
 	}
+	for (size_t i = 0; i != MinimapDirtyAreas.size(); ++i) {
+		const MinimapArea &area = MinimapDirtyAreas[i];
+
+		for (int y = area.Y; y < area.Y + area.H; ++y) {
+			std::fill_n(&MinimapDirty[area.X + y * W], area.W, 0);
+		}
+	}
+	MinimapDirtyAreas.clear();
 }
 
 /**
@@ -679,6 +917,11 @@ void CMinimap::Destroy()
 	Minimap2MapX = NULL;
 	delete[] Minimap2MapY;
 	Minimap2MapY = NULL;
+	std::vector<char>().swap(MinimapDirty);
+	MinimapDirtyAreas.clear();
+	MinimapDots.clear();
+	MinimapDotUpdates.clear();
+	MinimapDotSlots.clear();
 }
 
 /**
@@ -39,6 +39,7 @@
 
 #include "iolib.h"
 #include "minimap.h"
+#include "pathfinder.h"
 #include "player.h"
 #include "script.h"
 #include "ui.h"
@@ -107,9 +108,12 @@ static int CclStratagusMap(lua_State *l)
 					Map.Info.MapHeight = LuaToNumber(l, -1);
 					lua_pop(l, 1);
 					lua_pop(l, 1);
+					if (Map.Info.MapWidth > MaxMapWidth || Map.Info.MapHeight > MaxMapHeight) {
+						LuaError(l, "map size %dx%d is too big" _C_ Map.Info.MapWidth _C_ Map.Info.MapHeight);
+					}
 
-					delete[] Map.Fields;
-					Map.Fields = new CMapField[Map.Info.MapWidth * Map.Info.MapHeight];
+					Map.FreeFields();
+					Map.Create();
 					// FIXME: this should be CreateMap or InitMap?
 				} else if (!strcmp(value, "fog-of-war")) {
 					Map.NoFogOfWar = false;
@@ -170,7 +174,10 @@ static int CclStratagusMap(lua_State *l)
 							if (!strcmp(value, "explored")) {
 								++j2;
 								lua_rawgeti(l, -1, j2 + 1);
-								Map.Fields[i].Visible[(int)LuaToNumber(l, -1)] = 1;
+								const int player = LuaToNumber(l, -1);
+								if (Map.HasPlayerCounters(player)) {
+									Map.Visible[player][i] = 1;
+								}
 								lua_pop(l, 1);
 							} else if (!strcmp(value, "human")) {
 								Map.Fields[i].Flags |= MapFieldHuman;
@@ -384,6 +391,9 @@ static int CclSetForestRegeneration(lua_State *l)
 	}
 	old = ForestRegeneration;
 	ForestRegeneration = i;
+	if (Map.Fields && old != i) {
+		Map.InitForestRegeneration();
+	}
 
 	lua_pushnumber(l, old);
 	return 1;
@@ -467,6 +477,8 @@ void SetTile(int tile, const Vec2i &pos, int value)
 #ifdef DEBUG
 		mf.TilesetTile = tile;
 #endif
+		Map.ScheduleForestRegeneration(Map.getIndex(pos));
+		PathfinderTilesChanged(pos, 1, 1);
 	}
 }
 
@@ -51,12 +51,18 @@ struct Node {
 	short int CostToGoal;     /// Estimated cost to goal
 	char InGoal;        /// is this point in the goal
 	char Direction;     /// Direction for trace back
+	unsigned int Generation;  /// Search which has written this node
+};
+
+struct CostMoveToCacheEntry {
+	int Cost;                 /// Cached result of CostMoveTo
+	unsigned int Generation;  /// Search which has computed Cost
 };
 
 struct Open {
 	Vec2i pos;
-	short int Costs; /// complete costs to goal
-	unsigned short int O;     /// Offset into matrix
+	int Costs;       /// complete costs to goal
+	unsigned int O;  /// Offset into matrix
 };
 
 //for 32 bit signed int
@@ -80,15 +86,6 @@ const int Heading2Y[9] = { -1, -1, 0, +1, +1, +1, 0, -1, 0 };
 int Heading2O[9];//heading to offset
 const int XY2Heading[3][3] = { {7, 6, 5}, {0, 0, 4}, {1, 2, 3}};
 
-/// cost matrix
-static Node *AStarMatrix;
-
-/// a list of close nodes, helps to speed up the matrix cleaning
-static int *CloseSet;
-static int CloseSetSize;
-static int Threshold;
-static int OpenSetMaxSize;
-static int AStarMatrixSize;
 #define MAX_CLOSE_SET_RATIO 4
 #define MAX_OPEN_SET_RATIO 8 // 10,16 to small
 
@@ -101,21 +98,90 @@ int AStarUnknownTerrainCost = 2;
 static int AStarMapWidth;
 static int AStarMapHeight;
 
-static int AStarGoalX;
-static int AStarGoalY;
+struct StatsNode;
 
 /**
-**  The Open set is handled by a stored array
-**  the end of the array holds the item with the smallest cost.
+**  State of an A* search.
+**
+**  A search only writes in its own context, so searches in different
+**  contexts can run at the same time as long as nothing changes the map.
 */
+class PathfinderContext
+{
+public:
+	PathfinderContext(int mapWidth, int mapHeight);
+	~PathfinderContext();
 
-/// The set of Open nodes
-static Open *OpenSet;
-/// The size of the open node set
-static int OpenSetSize;
+	int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+					  int tilesizex, int tilesizey, int minrange, int maxrange,
+					  char *path, int pathlen, const CUnit &unit);
+	StatsNode *AStarGetStats() const;
+	const AStarCounters &GetCounters() const { return Counters; }
 
-static int *CostMoveToCache;
-static const int CacheNotSet = -5;
+private:
+	PathfinderContext(const PathfinderContext &); // Not implemented
+	PathfinderContext &operator =(const PathfinderContext &); // Not implemented
+
+	void AStarNewSearch();
+	Node &AStarNode(int o);
+	bool AStarOpenLess(const Open &lhs, const Open &rhs) const;
+	void AStarHeapUp(int pos);
+	void AStarHeapDown(int pos);
+	void AStarClearOpenSet();
+	void AStarRemoveMinimum(int pos);
+	int AStarAddNode(const Vec2i &pos, int o, int costs);
+	void AStarReplaceNode(int pos, int costs);
+	int AStarFindNode(int eo) const { return OpenSetIndex[eo]; }
+	void AStarAddToClose();
+	int CostMoveTo(unsigned int index, const CUnit &unit);
+	int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
+					  int tilesizex, int tilesizey, int minrange, int maxrange,
+					  int startRegion, const CUnit &unit);
+	int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path, int pathLen) const;
+	int AStarFindSimplePath(const Vec2i &startPos, const Vec2i &goal, int gw, int gh,
+							int tilesizex, int tilesizey, int minrange, int maxrange,
+							char *path, int pathlen, const CUnit &unit);
+
+	friend class AStarGoalMarker;
+
+private:
+	/// cost matrix, only the nodes of the current generation are valid
+	Node *AStarMatrix;
+	int AStarMatrixSize;
+	/// Generation of the current search
+	unsigned int Generation;
+
+	/// number of close nodes, above Threshold the matrix used to be cleared
+	int CloseSetSize;
+	int Threshold;
+
+	/**
+	**  The Open set is handled by a binary heap
+	**  the front of the array holds the item with the smallest cost.
+	**  OpenSetIndex gives for each matrix offset its position in the heap,
+	**  so that looking up and improving an open node doesn't need a scan.
+	*/
+
+	/// The set of Open nodes
+	Open *OpenSet;
+	/// The size of the open node set
+	int OpenSetSize;
+	int OpenSetMaxSize;
+	/// Position of each matrix node in the open set, -1 if not in it
+	int *OpenSetIndex;
+
+	CostMoveToCacheEntry *CostMoveToCache;
+	/// Clearances for the mask of the unit searching, may be NULL
+	const unsigned char *Clearances;
+
+	int AStarGoalX;
+	int AStarGoalY;
+
+	AStarCounters Counters;
+};
+
+/// Context of the searches done by the game loop
+static PathfinderContext *MainContext;
 
 /*----------------------------------------------------------------------------
 --  Profile
@@ -241,32 +307,52 @@ inline void ProfilePrint()
 --  Functions
 ----------------------------------------------------------------------------*/
 
+/**
+**  Allocate the data structures of a search.
+*/
+PathfinderContext::PathfinderContext(int mapWidth, int mapHeight) :
+	Generation(0), CloseSetSize(0), OpenSetSize(0), Clearances(NULL), AStarGoalX(0), AStarGoalY(0)
+{
+	AStarMatrixSize = sizeof(Node) * mapWidth * mapHeight;
+	AStarMatrix = new Node[mapWidth * mapHeight];
+	memset(AStarMatrix, 0, AStarMatrixSize);
+
+	Threshold = mapWidth * mapHeight / MAX_CLOSE_SET_RATIO;
+
+	OpenSetMaxSize = mapWidth * mapHeight / MAX_OPEN_SET_RATIO;
+	OpenSet = new Open[OpenSetMaxSize];
+	OpenSetIndex = new int[mapWidth * mapHeight];
+	memset(OpenSetIndex, 0xFF, sizeof(int) * mapWidth * mapHeight);
+
+	CostMoveToCache = new CostMoveToCacheEntry[mapWidth * mapHeight];
+	memset(CostMoveToCache, 0, sizeof(CostMoveToCacheEntry) * mapWidth * mapHeight);
+
+	memset(&Counters, 0, sizeof(Counters));
+}
+
+PathfinderContext::~PathfinderContext()
+{
+	delete[] AStarMatrix;
+	delete[] OpenSet;
+	delete[] OpenSetIndex;
+	delete[] CostMoveToCache;
+}
+
 /**
 **  Init A* data structures
 */
 void InitAStar(int mapWidth, int mapHeight)
 {
 	// Should only be called once
-	Assert(!AStarMatrix);
+	Assert(!MainContext);
 
 	AStarMapWidth = mapWidth;
 	AStarMapHeight = mapHeight;
 
-	AStarMatrixSize = sizeof(Node) * AStarMapWidth * AStarMapHeight;
-	AStarMatrix = new Node[AStarMapWidth * AStarMapHeight];
-	memset(AStarMatrix, 0, AStarMatrixSize);
-
-	Threshold = AStarMapWidth * AStarMapHeight / MAX_CLOSE_SET_RATIO;
-	CloseSet = new int[Threshold];
-
-	OpenSetMaxSize = AStarMapWidth * AStarMapHeight / MAX_OPEN_SET_RATIO;
-	OpenSet = new Open[OpenSetMaxSize];
-
-	CostMoveToCache = new int[AStarMapWidth * AStarMapHeight];
-
 	for (int i = 0; i < 9; ++i) {
 		Heading2O[i] = Heading2Y[i] * AStarMapWidth;
 	}
+	MainContext = new PathfinderContext(AStarMapWidth, AStarMapHeight);
 
 	ProfileInit();
 }
@@ -276,105 +362,176 @@ void InitAStar(int mapWidth, int mapHeight)
 */
 void FreeAStar()
 {
-	delete[] AStarMatrix;
-	AStarMatrix = NULL;
-	delete[] CloseSet;
-	CloseSet = NULL;
-	CloseSetSize = 0;
-	delete[] OpenSet;
-	OpenSet = NULL;
-	OpenSetSize = 0;
-	delete[] CostMoveToCache;
-	CostMoveToCache = NULL;
+	delete MainContext;
+	MainContext = NULL;
 
 	ProfilePrint();
 }
 
 /**
-**  Prepare pathfinder.
+**  Make a context for searches out of the game loop.
+**
+**  InitAStar must have been called, the context has the size of the map.
 */
-static void AStarPrepare()
+PathfinderContext *NewPathfinderContext()
 {
-	memset(AStarMatrix, 0, AStarMatrixSize);
+	return new PathfinderContext(AStarMapWidth, AStarMapHeight);
 }
 
 /**
-**  Clean up A*
+**  Free a context made by NewPathfinderContext.
 */
-static void AStarCleanUp()
+void DeletePathfinderContext(PathfinderContext *context)
 {
-	ProfileBegin("AStarCleanUp");
+	delete context;
+}
 
+/**
+**  Start a new search.
+**
+**  Nodes and cached costs of the previous searches are recognized by
+**  their generation, nothing has to be cleaned. Only when the counter
+**  wraps around the whole matrix is cleared.
+*/
+void PathfinderContext::AStarNewSearch()
+{
+	++Counters.Searches;
 	if (CloseSetSize >= Threshold) {
-		AStarPrepare();
-	} else {
-		for (int i = 0; i < CloseSetSize; ++i) {
-			AStarMatrix[CloseSet[i]].CostFromStart = 0;
-			AStarMatrix[CloseSet[i]].InGoal = 0;
-		}
+		// Previous search would have needed a full clear of the matrix.
+		++Counters.FullClearsAvoided;
+	}
+	CloseSetSize = 0;
+
+	++Generation;
+	if (Generation == 0) {
+		ProfileBegin("AStarNewSearch");
+		const int size = AStarMatrixSize / sizeof(Node);
+		memset(AStarMatrix, 0, AStarMatrixSize);
+		memset(CostMoveToCache, 0, sizeof(CostMoveToCacheEntry) * size);
+		Generation = 1;
+		++Counters.FullClears;
+		ProfileEnd("AStarNewSearch");
 	}
-	ProfileEnd("AStarCleanUp");
 }
 
-static void CostMoveToCacheCleanUp()
+/**
+**  Get a node for the current search, resetting it if it is older.
+*/
+inline Node &PathfinderContext::AStarNode(int o)
 {
-	ProfileBegin("CostMoveToCacheCleanUp");
-	int AStarMapMax =  AStarMapWidth * AStarMapHeight;
-#if 1
-	int *ptr = CostMoveToCache;
-#ifdef __x86_64__
-	union {
-		intptr_t d;
-		int i[2];
-	} conv;
-	conv.i[0] = CacheNotSet;
-	conv.i[1] = CacheNotSet;
-
-	if (((uintptr_t)ptr) & 4) {
-		*ptr++ = CacheNotSet;
-		--AStarMapMax;
+	Node &node = AStarMatrix[o];
+
+	if (node.Generation != Generation) {
+		node.CostFromStart = 0;
+		node.InGoal = 0;
+		node.Generation = Generation;
 	}
-#endif
-	while (AStarMapMax > 3) {
-#ifdef __x86_64__
-		*((intptr_t *)ptr) = conv.d;
-		*((intptr_t *)(ptr + 2)) = conv.d;
-		ptr += 4;
-#else
-		*ptr++ = CacheNotSet;
-		*ptr++ = CacheNotSet;
-		*ptr++ = CacheNotSet;
-		*ptr++ = CacheNotSet;
-#endif
-		AStarMapMax -= 4;
-	};
-	while (AStarMapMax) {
-		*ptr++ = CacheNotSet;
-		--AStarMapMax;
+	return node;
+}
+
+/**
+**  Compare two nodes of the open set.
+**  Lowest complete costs first, then nearest to goal (estimated cost,
+**  then manhattan distance) to keep paths deterministic.
+**
+**  @return  true if lhs has to be expanded before rhs.
+*/
+bool PathfinderContext::AStarOpenLess(const Open &lhs, const Open &rhs) const
+{
+	if (lhs.Costs != rhs.Costs) {
+		return lhs.Costs < rhs.Costs;
 	}
-#else
-	for (int i = 0; i < AStarMapMax; ++i) {
-		CostMoveToCache[i] = CacheNotSet;
+	const int lhsCostToGoal = AStarMatrix[lhs.O].CostToGoal;
+	const int rhsCostToGoal = AStarMatrix[rhs.O].CostToGoal;
+	if (lhsCostToGoal != rhsCostToGoal) {
+		return lhsCostToGoal < rhsCostToGoal;
 	}
-#endif
-	ProfileEnd("CostMoveToCacheCleanUp");
+	const int lhsDist = MyAbs(lhs.pos.x - AStarGoalX) + MyAbs(lhs.pos.y - AStarGoalY);
+	const int rhsDist = MyAbs(rhs.pos.x - AStarGoalX) + MyAbs(rhs.pos.y - AStarGoalY);
+	return lhsDist < rhsDist;
+}
+
+/**
+**  Move the node at pos toward the front of the open set
+**  until the heap property is restored.
+*/
+void PathfinderContext::AStarHeapUp(int pos)
+{
+	const Open node = OpenSet[pos];
+
+	while (pos > 0) {
+		const int parent = (pos - 1) >> 1;
+		if (!AStarOpenLess(node, OpenSet[parent])) {
+			break;
+		}
+		OpenSet[pos] = OpenSet[parent];
+		OpenSetIndex[OpenSet[pos].O] = pos;
+		pos = parent;
+	}
+	OpenSet[pos] = node;
+	OpenSetIndex[node.O] = pos;
+}
+
+/**
+**  Move the node at pos toward the back of the open set
+**  until the heap property is restored.
+*/
+void PathfinderContext::AStarHeapDown(int pos)
+{
+	const Open node = OpenSet[pos];
+
+	while (1) {
+		int child = 2 * pos + 1;
+		if (child >= OpenSetSize) {
+			break;
+		}
+		if (child + 1 < OpenSetSize && AStarOpenLess(OpenSet[child + 1], OpenSet[child])) {
+			++child;
+		}
+		if (!AStarOpenLess(OpenSet[child], node)) {
+			break;
+		}
+		OpenSet[pos] = OpenSet[child];
+		OpenSetIndex[OpenSet[pos].O] = pos;
+		pos = child;
+	}
+	OpenSet[pos] = node;
+	OpenSetIndex[node.O] = pos;
+}
+
+/**
+**  Empty the open set, forgetting the nodes left by the last search.
+*/
+void PathfinderContext::AStarClearOpenSet()
+{
+	for (int i = 0; i < OpenSetSize; ++i) {
+		OpenSetIndex[OpenSet[i].O] = -1;
+	}
+	OpenSetSize = 0;
 }
 
 /**
 **  Find the best node in the current open node set
 **  Returns the position of this node in the open node set
 */
-#define AStarFindMinimum() (OpenSetSize - 1)
+#define AStarFindMinimum() (0)
 
 
 /**
 **  Remove the minimum from the open node set
 */
-static void AStarRemoveMinimum(int pos)
+void PathfinderContext::AStarRemoveMinimum(int pos)
 {
-	Assert(pos == OpenSetSize - 1);
-
-	OpenSetSize--;
+	ProfileBegin("AStarRemoveMinimum");
+	Assert(pos == 0 && OpenSetSize > 0);
+
+	OpenSetIndex[OpenSet[0].O] = -1;
+	--OpenSetSize;
+	if (OpenSetSize > 0) {
+		OpenSet[0] = OpenSet[OpenSetSize];
+		AStarHeapDown(0);
+	}
+	ProfileEnd("AStarRemoveMinimum");
 }
 
 /**
@@ -382,17 +539,10 @@ static void AStarRemoveMinimum(int pos)
 **
 **  @return  0 or PF_FAILED
 */
-static inline int AStarAddNode(const Vec2i &pos, int o, int costs)
+int PathfinderContext::AStarAddNode(const Vec2i &pos, int o, int costs)
 {
 	ProfileBegin("AStarAddNode");
 
-	int bigi = 0, smalli = OpenSetSize;
-	int midcost;
-	int midi;
-	int midCostToGoal;
-	int midDist;
-	const Open *open;
-
 	if (OpenSetSize + 1 >= OpenSetMaxSize) {
 		fprintf(stderr, "A* internal error: raise Open Set Max Size "
 				"(current value %d)\n", OpenSetMaxSize);
@@ -400,45 +550,13 @@ static inline int AStarAddNode(const Vec2i &pos, int o, int costs)
 		return PF_FAILED;
 	}
 
-	const int costToGoal = AStarMatrix[o].CostToGoal;
-	const int dist = MyAbs(pos.x - AStarGoalX) + MyAbs(pos.y - AStarGoalY);
-
-	// find where we should insert this node.
-	// binary search where to insert the new node
-	while (bigi < smalli) {
-		midi = (smalli + bigi) >> 1;
-		open = &OpenSet[midi];
-		midcost = open->Costs;
-		midCostToGoal = AStarMatrix[open->O].CostToGoal;
-		midDist = MyAbs(open->pos.x - AStarGoalX) + MyAbs(open->pos.y - AStarGoalY);
-		if (costs > midcost || (costs == midcost
-								&& (costToGoal > midCostToGoal || (costToGoal == midCostToGoal
-																   && dist > midDist)))) {
-			smalli = midi;
-		} else if (costs < midcost || (costs == midcost
-									   && (costToGoal < midCostToGoal || (costToGoal == midCostToGoal
-											   && dist < midDist)))) {
-			if (bigi == midi) {
-				bigi++;
-			} else {
-				bigi = midi;
-			}
-		} else {
-			bigi = midi;
-			smalli = midi;
-		}
-	}
-
-	if (OpenSetSize > bigi) {
-		// free a the slot for our node
-		memmove(&OpenSet[bigi + 1], &OpenSet[bigi], (OpenSetSize - bigi) * sizeof(Open));
-	}
-
-	// fill our new node
-	OpenSet[bigi].pos = pos;
-	OpenSet[bigi].O = o;
-	OpenSet[bigi].Costs = costs;
+	// fill our new node at the back and let it bubble up
+	Open &node = OpenSet[OpenSetSize];
+	node.pos = pos;
+	node.O = o;
+	node.Costs = costs;
 	++OpenSetSize;
+	AStarHeapUp(OpenSetSize - 1);
 
 	ProfileEnd("AStarAddNode");
 
@@ -447,60 +565,41 @@ static inline int AStarAddNode(const Vec2i &pos, int o, int costs)
 
 /**
 **  Change the cost associated to an open node.
-**  Can be further optimised knowing that the new cost MUST BE LOWER
-**  than the old one.
+**  The new cost MUST BE LOWER than the old one.
 */
-static void AStarReplaceNode(int pos, int)
+void PathfinderContext::AStarReplaceNode(int pos, int costs)
 {
 	ProfileBegin("AStarReplaceNode");
 
-	Open node;
-
-	// Remove the outdated node
-	node = OpenSet[pos];
-	OpenSetSize--;
-	//memmove(&OpenSet[pos], &OpenSet[pos+1], sizeof(Open) * (OpenSetSize-pos));
-	memcpy(&OpenSet[pos], &OpenSet[pos + 1], sizeof(Open) * (OpenSetSize - pos));
+	Assert(costs <= OpenSet[pos].Costs);
+	OpenSet[pos].Costs = costs;
+	AStarHeapUp(pos);
 
-	// Re-add the node with the new cost
-	AStarAddNode(node.pos, node.O, node.Costs);
 	ProfileEnd("AStarReplaceNode");
 }
 
-
 /**
-**  Check if a node is already in the open set.
+**  Count a node added to the closed set.
 **
-**  @return  -1 if not found and the position of the node in the table if found.
+**  Nodes are closed by their generation, only the count is kept.
 */
-static int AStarFindNode(int eo)
-{
-	ProfileBegin("AStarFindNode");
-
-	for (int i = 0; i < OpenSetSize; ++i) {
-		if (OpenSet[i].O == eo) {
-			ProfileEnd("AStarFindNode");
-			return i;
-		}
-	}
-	ProfileEnd("AStarFindNode");
-	return -1;
-}
-
-/**
-**  Add a node to the closed set
-*/
-static void AStarAddToClose(int node)
+void PathfinderContext::AStarAddToClose()
 {
 	if (CloseSetSize < Threshold) {
-		CloseSet[CloseSetSize++] = node;
+		++CloseSetSize;
 	}
 }
 
 #define GetIndex(x, y) (x) + (y) * AStarMapWidth
 
-/* build-in costmoveto code */
-static int CostMoveToCallBack_Default(unsigned int index, const CUnit &unit)
+/**
+**  build-in costmoveto code
+**
+**  @param clearances  Clearances for the mask of the unit, may be NULL.
+**                     A big unit then sees at once if the terrain under
+**                     it is free, and only the units still need a check.
+*/
+static int CostMoveToCallBack_Default(unsigned int index, const CUnit &unit, const unsigned char *clearances)
 {
 #ifdef DEBUG
 	{
@@ -515,14 +614,25 @@ static int CostMoveToCallBack_Default(unsigned int index, const CUnit &unit)
 	const CUnitTypeFinder unit_finder((UnitTypeType)unit.Type->UnitType);
 	const unsigned int player_index = unit.Player->Index;
 
-	// verify each tile of the unit.
 	int h = unit.Type->TileHeight;
 	const int w = unit.Type->TileWidth;
+	int tileMask = mask;
+	if (clearances && (w > 1 || h > 1)) {
+		const int clearance = clearances[index];
+		if (clearance >= std::max(w, h)) {
+			// no fixed obstacle under the unit, only other units can be.
+			tileMask &= MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit;
+		} else if (AStarKnowUnseenTerrain && clearance < std::min(w, h) && clearance < MAX_MAP_CLEARANCE) {
+			return -1;
+		}
+	}
+
+	// verify each tile of the unit.
 	do {
 		const CMapField *mf = Map.Field(index);
 		int i = w;
 		do {
-			const int flag = mf->Flags & mask;
+			const int flag = mf->Flags & tileMask;
 			if (flag && (AStarKnowUnseenTerrain || mf->IsExplored(player_index))) {
 				if (flag & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)) {
 					// we can't cross fixed units and other unpassable things
@@ -572,32 +682,44 @@ static int CostMoveToCallBack_Default(unsigned int index, const CUnit &unit)
 **                0 -> no induced cost, except move
 **               >0 -> costly tile
 */
-static inline int CostMoveTo(unsigned int index, const CUnit &unit)
+inline int PathfinderContext::CostMoveTo(unsigned int index, const CUnit &unit)
 {
-	int *c = &CostMoveToCache[index];
-	if (*c != CacheNotSet) {
-		return *c;
+	CostMoveToCacheEntry &entry = CostMoveToCache[index];
+	if (entry.Generation != Generation) {
+		entry.Cost = CostMoveToCallBack_Default(index, unit, Clearances);
+		entry.Generation = Generation;
 	}
-	*c = CostMoveToCallBack_Default(index, unit);
-	return *c;
+	return entry.Cost;
+}
+
+/**
+**  Check if a tile is connected by terrain to the start of the path.
+**
+**  @param startRegion  Region of the start, 0 to check nothing.
+*/
+static inline bool IsInStartRegion(unsigned int index, const CUnit &unit, int startRegion)
+{
+	return startRegion == 0 || GetMapRegion(unit.Type->MovementMask, index) == startRegion;
 }
 
 class AStarGoalMarker
 {
 public:
-	AStarGoalMarker(const CUnit &unit, bool *goal_reachable) :
-		unit(unit), goal_reachable(goal_reachable)
+	AStarGoalMarker(PathfinderContext &context, const CUnit &unit, int startRegion, bool *goal_reachable) :
+		context(context), unit(unit), startRegion(startRegion), goal_reachable(goal_reachable)
 	{}
 
 	void operator()(int offset) const {
-		if (CostMoveTo(offset, unit) >= 0) {
-			AStarMatrix[offset].InGoal = 1;
+		if (IsInStartRegion(offset, unit, startRegion) && context.CostMoveTo(offset, unit) >= 0) {
+			context.AStarNode(offset).InGoal = 1;
 			*goal_reachable = true;
 		}
-		AStarAddToClose(offset);
+		context.AStarAddToClose();
 	}
 private:
+	PathfinderContext &context;
 	const CUnit &unit;
+	int startRegion;
 	bool *goal_reachable;
 };
 
@@ -750,8 +872,9 @@ private:
 /**
 **  MarkAStarGoal
 */
-static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
-						 int tilesizex, int tilesizey, int minrange, int maxrange, const CUnit &unit)
+int PathfinderContext::AStarMarkGoal(const Vec2i &goal, int gw, int gh,
+									  int tilesizex, int tilesizey, int minrange, int maxrange,
+									  int startRegion, const CUnit &unit)
 {
 	ProfileBegin("AStarMarkGoal");
 
@@ -761,8 +884,8 @@ static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
 			return 0;
 		}
 		unsigned int offset = GetIndex(goal.x, goal.y);
-		if (CostMoveTo(offset, unit) >= 0) {
-			AStarMatrix[offset].InGoal = 1;
+		if (IsInStartRegion(offset, unit, startRegion) && CostMoveTo(offset, unit) >= 0) {
+			AStarNode(offset).InGoal = 1;
 			ProfileEnd("AStarMarkGoal");
 			return 1;
 		} else {
@@ -776,7 +899,7 @@ static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
 	gw = std::max(gw, 1);
 	gh = std::max(gh, 1);
 
-	AStarGoalMarker aStarGoalMarker(unit, &goal_reachable);
+	AStarGoalMarker aStarGoalMarker(*this, unit, startRegion, &goal_reachable);
 	MinMaxRangeVisitor<AStarGoalMarker> visitor(aStarGoalMarker);
 
 	const Vec2i goalBottomRigth(goal.x + gw - 1, goal.y + gh - 1);
@@ -793,12 +916,50 @@ static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
 	return goal_reachable;
 }
 
+class AStarGoalCollector
+{
+public:
+	explicit AStarGoalCollector(std::vector<unsigned int> *tiles) : tiles(tiles) {}
+
+	void operator()(int offset) const { tiles->push_back(offset); }
+private:
+	std::vector<unsigned int> *tiles;
+};
+
+/**
+**  Get the tiles from where a unit is in range of the goal.
+**
+**  Same tiles as AStarMarkGoal, without checking if they can be entered.
+*/
+void AStarGetGoalTiles(const Vec2i &goal, int gw, int gh,
+					   int tilesizex, int tilesizey, int minrange, int maxrange,
+					   std::vector<unsigned int> &tiles)
+{
+	tiles.clear();
+	if (minrange == 0 && maxrange == 0 && gw == 0 && gh == 0) {
+		if (goal.x + tilesizex <= AStarMapWidth && goal.y + tilesizey <= AStarMapHeight) {
+			tiles.push_back(GetIndex(goal.x, goal.y));
+		}
+		return;
+	}
+	gw = std::max(gw, 1);
+	gh = std::max(gh, 1);
+
+	AStarGoalCollector collector(&tiles);
+	MinMaxRangeVisitor<AStarGoalCollector> visitor(collector);
+
+	visitor.SetGoal(goal, Vec2i(goal.x + gw - 1, goal.y + gh - 1));
+	visitor.SetRange(minrange, maxrange);
+	visitor.SetUnitSize(Vec2i(tilesizex, tilesizey));
+	visitor.Visit();
+}
+
 /**
 **  Save the path
 **
 **  @return  The length of the path
 */
-static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path, int pathLen)
+int PathfinderContext::AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path, int pathLen) const
 {
 	ProfileBegin("AStarSavePath");
 
@@ -844,9 +1005,9 @@ static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path,
 **  Optimization to find a simple path
 **  Check if we're at the goal or if it's 1 tile away
 */
-static int AStarFindSimplePath(const Vec2i &startPos, const Vec2i &goal, int gw, int gh,
-							   int, int, int minrange, int maxrange,
-							   char *path, int, const CUnit &unit)
+int PathfinderContext::AStarFindSimplePath(const Vec2i &startPos, const Vec2i &goal, int gw, int gh,
+											int, int, int minrange, int maxrange,
+											char *path, int, const CUnit &unit)
 {
 	ProfileBegin("AStarFindSimplePath");
 	// At exact destination point already
@@ -891,9 +1052,9 @@ static int AStarFindSimplePath(const Vec2i &startPos, const Vec2i &goal, int gw,
 /**
 **  Find path.
 */
-int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
-				  int tilesizex, int tilesizey, int minrange, int maxrange,
-				  char *path, int pathlen, const CUnit &unit)
+int PathfinderContext::AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+									 int tilesizex, int tilesizey, int minrange, int maxrange,
+									 char *path, int pathlen, const CUnit &unit)
 {
 	Assert(Map.Info.IsPointOnMap(startPos));
 
@@ -901,6 +1062,7 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 
 	AStarGoalX = goalPos.x;
 	AStarGoalY = goalPos.y;
+	Clearances = GetMapClearances(unit.Type->MovementMask);
 
 	//  Check for simple cases first
 	int ret = AStarFindSimplePath(startPos, goalPos, gw, gh, tilesizex, tilesizey,
@@ -911,13 +1073,19 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	}
 
 	//  Initialize
-	AStarCleanUp();
-	CostMoveToCacheCleanUp();
-
-	OpenSetSize = 0;
-	CloseSetSize = 0;
-
-	if (!AStarMarkGoal(goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit)) {
+	AStarNewSearch();
+	AStarClearOpenSet();
+
+	// Goal tiles out of the region of the start can't be reached whatever
+	// the units do, don't flood the map to find it out.
+	// Regions know the whole map, the AI already does. They are updated
+	// when asked, SolvePathRequests updates them before the searches
+	// of other contexts read them.
+	int startRegion = 0;
+	if (AStarKnowUnseenTerrain || unit.Player->AiEnabled) {
+		startRegion = GetMapRegion(unit.Type->MovementMask, GetIndex(startPos.x, startPos.y));
+	}
+	if (!AStarMarkGoal(goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, startRegion, unit)) {
 		// goal is not reachable
 		ret = PF_UNREACHABLE;
 		ProfileEnd("AStarFindPath");
@@ -925,22 +1093,23 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	}
 
 	int eo = startPos.y * AStarMapWidth + startPos.x;
+	Node &startNode = AStarNode(eo);
 	// it is quite important to start from 1 rather than 0, because we use
 	// 0 as a way to represent nodes that we have not visited yet.
-	AStarMatrix[eo].CostFromStart = 1;
+	startNode.CostFromStart = 1;
 	// 8 to say we are came from nowhere.
-	AStarMatrix[eo].Direction = 8;
+	startNode.Direction = 8;
 
 	// place start point in open, it that failed, try another pathfinder
 	int costToGoal = AStarCosts(startPos, goalPos);
-	AStarMatrix[eo].CostToGoal = costToGoal;
+	startNode.CostToGoal = costToGoal;
 	if (AStarAddNode(startPos, eo, 1 + costToGoal) == PF_FAILED) {
 		ret = PF_FAILED;
 		ProfileEnd("AStarFindPath");
 		return ret;
 	}
-	AStarAddToClose(OpenSet[0].O);
-	if (AStarMatrix[eo].InGoal) {
+	AStarAddToClose();
+	if (startNode.InGoal) {
 		ret = PF_REACHED;
 		ProfileEnd("AStarFindPath");
 		return ret;
@@ -1014,38 +1183,39 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 			// Add a cost for walking to make paths more realistic for the user.
 			new_cost++;
 			new_cost += AStarMatrix[o].CostFromStart;
-			if (AStarMatrix[eo].CostFromStart == 0) {
+			Node &endNode = AStarNode(eo);
+			if (endNode.CostFromStart == 0) {
 				// we are sure the current node has not been already visited
-				AStarMatrix[eo].CostFromStart = new_cost;
-				AStarMatrix[eo].Direction = i;
+				endNode.CostFromStart = new_cost;
+				endNode.Direction = i;
 				costToGoal = AStarCosts(endPos, goalPos);
-				AStarMatrix[eo].CostToGoal = costToGoal;
-				if (AStarAddNode(endPos, eo, AStarMatrix[eo].CostFromStart + costToGoal) == PF_FAILED) {
+				endNode.CostToGoal = costToGoal;
+				if (AStarAddNode(endPos, eo, endNode.CostFromStart + costToGoal) == PF_FAILED) {
 					ret = PF_FAILED;
 					ProfileEnd("AStarFindPath");
 					return ret;
 				}
 				// we add the point to the close set
-				AStarAddToClose(eo);
-			} else if (new_cost < AStarMatrix[eo].CostFromStart) {
+				AStarAddToClose();
+			} else if (new_cost < endNode.CostFromStart) {
 				// Already visited node, but we have here a better path
 				// I know, it's redundant (but simpler like this)
-				AStarMatrix[eo].CostFromStart = new_cost;
-				AStarMatrix[eo].Direction = i;
+				endNode.CostFromStart = new_cost;
+				endNode.Direction = i;
 				// this point might be already in the OpenSet
 				const int j = AStarFindNode(eo);
 				if (j == -1) {
 					costToGoal = AStarCosts(endPos, goalPos);
-					AStarMatrix[eo].CostToGoal = costToGoal;
-					if (AStarAddNode(endPos, eo, AStarMatrix[eo].CostFromStart + costToGoal) == PF_FAILED) {
+					endNode.CostToGoal = costToGoal;
+					if (AStarAddNode(endPos, eo, endNode.CostFromStart + costToGoal) == PF_FAILED) {
 						ret = PF_FAILED;
 						ProfileEnd("AStarFindPath");
 						return ret;
 					}
 				} else {
 					costToGoal = AStarCosts(endPos, goalPos);
-					AStarMatrix[eo].CostToGoal = costToGoal;
-					AStarReplaceNode(j, AStarMatrix[eo].CostFromStart + costToGoal);
+					endNode.CostToGoal = costToGoal;
+					AStarReplaceNode(j, endNode.CostFromStart + costToGoal);
 				}
 				// we don't have to add this point to the close set
 			}
@@ -1065,6 +1235,28 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	return ret;
 }
 
+/**
+**  Find path with the context of the game loop.
+*/
+int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+				  int tilesizex, int tilesizey, int minrange, int maxrange,
+				  char *path, int pathlen, const CUnit &unit)
+{
+	return MainContext->AStarFindPath(startPos, goalPos, gw, gh, tilesizex, tilesizey,
+									  minrange, maxrange, path, pathlen, unit);
+}
+
+/**
+**  Find path with the given context.
+*/
+int AStarFindPath(PathfinderContext &context, const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+				  int tilesizex, int tilesizey, int minrange, int maxrange,
+				  char *path, int pathlen, const CUnit &unit)
+{
+	return context.AStarFindPath(startPos, goalPos, gw, gh, tilesizex, tilesizey,
+								 minrange, maxrange, path, pathlen, unit);
+}
+
 struct StatsNode {
 	StatsNode() : Direction(0), InGoal(0), CostFromStart(0), Costs(0), CostToGoal(0) {}
 
@@ -1075,14 +1267,19 @@ struct StatsNode {
 	int CostToGoal;
 };
 
-StatsNode *AStarGetStats()
+StatsNode *PathfinderContext::AStarGetStats() const
 {
 	StatsNode *stats = new StatsNode[AStarMapWidth * AStarMapHeight];
 	StatsNode *s = stats;
-	Node *m = AStarMatrix;
+	const Node *m = AStarMatrix;
 
 	for (int j = 0; j < AStarMapHeight; ++j) {
 		for (int i = 0; i < AStarMapWidth; ++i) {
+			if (m->Generation != Generation) { // Not reached by the last search
+				++s;
+				++m;
+				continue;
+			}
 			s->Direction = m->Direction;
 			s->InGoal = m->InGoal;
 			s->CostFromStart = m->CostFromStart;
@@ -1098,6 +1295,21 @@ StatsNode *AStarGetStats()
 	return stats;
 }
 
+StatsNode *AStarGetStats()
+{
+	return MainContext->AStarGetStats();
+}
+
+/**
+**  Get the counters of the searches of the game loop.
+*/
+const AStarCounters &GetAStarCounters()
+{
+	static const AStarCounters noCounters = {0, 0, 0};
+
+	return MainContext ? MainContext->GetCounters() : noCounters;
+}
+
 void AStarFreeStats(StatsNode *stats)
 {
 	delete[] stats;
@@ -0,0 +1,186 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name clearance.cpp - Clearance of the map tiles. */
+//
+//      For each movement mask, the clearance of a tile is the size of the
+//      biggest square, with this tile as top left corner, which has no
+//      static obstacle. A unit of NxN tiles can stand on a tile if its
+//      clearance is at least N.
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "pathfinder.h"
+
+#include "map.h"
+
+#include <algorithm>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/// Unit flags, they are not static obstacles
+static const int UnitFieldFlags = MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit;
+
+/**
+**  Clearance of each tile of the map for one movement mask.
+*/
+class CClearanceLayer
+{
+public:
+	explicit CClearanceLayer(int mask) : Mask(mask & ~UnitFieldFlags) {}
+
+	void Init();
+	void Update(const Vec2i &pos);
+
+	int GetMask() const { return Mask; }
+	const unsigned char *GetClearances() const { return Clearances.empty() ? NULL : &Clearances[0]; }
+
+private:
+	void ComputeArea(const Vec2i &topLeft, const Vec2i &bottomRight);
+
+private:
+	int Mask;                              /// Static part of the movement mask
+	std::vector<unsigned char> Clearances; /// Clearance of each tile
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+/// Clearances for each movement mask in use
+static std::vector<CClearanceLayer> ClearanceLayers;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Compute the clearance of an area, from the bottom right.
+**
+**  The tiles at the right and under the area must be up to date.
+*/
+void CClearanceLayer::ComputeArea(const Vec2i &topLeft, const Vec2i &bottomRight)
+{
+	const int width = Map.Info.MapWidth;
+
+	for (int y = bottomRight.y; y >= topLeft.y; --y) {
+		for (int x = bottomRight.x; x >= topLeft.x; --x) {
+			const unsigned int index = x + y * width;
+
+			if (Map.CheckMask(index, Mask)) {
+				Clearances[index] = 0;
+				continue;
+			}
+			// Out of the map counts as an obstacle.
+			const int right = x + 1 < width ? Clearances[index + 1] : 0;
+			const int bottom = y + 1 < Map.Info.MapHeight ? Clearances[index + width] : 0;
+			const int diagonal = (x + 1 < width && y + 1 < Map.Info.MapHeight) ? Clearances[index + width + 1] : 0;
+
+			Clearances[index] = std::min(1 + std::min(std::min(right, bottom), diagonal), MAX_MAP_CLEARANCE);
+		}
+	}
+}
+
+/**
+**  Compute the clearance of the whole map.
+*/
+void CClearanceLayer::Init()
+{
+	Clearances.assign(Map.Info.MapWidth * Map.Info.MapHeight, 0);
+	ComputeArea(Vec2i(0, 0), Vec2i(Map.Info.MapWidth - 1, Map.Info.MapHeight - 1));
+}
+
+/**
+**  Passability of a tile has changed, update the tiles which can see it.
+*/
+void CClearanceLayer::Update(const Vec2i &pos)
+{
+	const Vec2i topLeft(std::max(0, pos.x - MAX_MAP_CLEARANCE + 1), std::max(0, pos.y - MAX_MAP_CLEARANCE + 1));
+
+	ComputeArea(topLeft, pos);
+}
+
+/**
+**  Init the clearances for the given movement masks.
+*/
+void InitMapClearances(const std::vector<int> &masks)
+{
+	ClearanceLayers.clear();
+	for (size_t i = 0; i != masks.size(); ++i) {
+		ClearanceLayers.push_back(CClearanceLayer(masks[i]));
+		ClearanceLayers.back().Init();
+	}
+}
+
+/**
+**  Free the clearances.
+*/
+void FreeMapClearances()
+{
+	ClearanceLayers.clear();
+}
+
+/**
+**  Static passability of a tile has changed.
+*/
+void MapClearancesTileChanged(const Vec2i &pos)
+{
+	for (size_t i = 0; i != ClearanceLayers.size(); ++i) {
+		ClearanceLayers[i].Update(pos);
+	}
+}
+
+/**
+**  Get the clearances of the map for a movement mask.
+**
+**  The clearance of a tile is the side of the biggest square without
+**  static obstacle which has this tile as top left corner. It stops at
+**  MAX_MAP_CLEARANCE, below it the value is exact.
+**
+**  @param movemask  Movement mask of the unit type.
+**
+**  @return          Clearance of each tile, NULL if the mask is unknown.
+*/
+const unsigned char *GetMapClearances(int movemask)
+{
+	const int mask = movemask & ~UnitFieldFlags;
+
+	for (size_t i = 0; i != ClearanceLayers.size(); ++i) {
+		if (ClearanceLayers[i].GetMask() == mask) {
+			return ClearanceLayers[i].GetClearances();
+		}
+	}
+	return NULL;
+}
+
+//@}
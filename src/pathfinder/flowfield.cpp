@@ -0,0 +1,398 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name flowfield.cpp - Flow fields shared by units going to a same goal. */
+//
+//      When many units ask for a path to the same goal in a short time
+//      (a group move or attack), the cost to reach the goal is computed
+//      once from every tile of the map, and each unit follows the
+//      direction given by its tile instead of running its own A*.
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "pathfinder.h"
+
+#include "map.h"
+#include "unit.h"
+#include "unittype.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits.h>
+#include <queue>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/// Get the tiles from where a unit is in range of the goal
+extern void AStarGetGoalTiles(const Vec2i &goal, int gw, int gh,
+							  int tilesizex, int tilesizey, int minrange, int maxrange,
+							  std::vector<unsigned int> &tiles);
+
+/// Number of units going to a goal in a short time to share a flow field
+static const int FlowFieldMinUnits = 8;
+/// Requests older than this are forgotten
+static const unsigned long FlowFieldRequestCycles = CYCLES_PER_SECOND;
+/// Under this distance to the goal, a plain path is cheaper
+static const int FlowFieldMinDistance = 16;
+/// A field not used for so long is freed
+static const unsigned long FlowFieldKeepCycles = 5 * CYCLES_PER_SECOND;
+/// Max number of fields kept at the same time
+static const size_t FlowFieldMaxCount = 8;
+/// Unit flags, they are not static obstacles
+static const int UnitFieldFlags = MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit;
+/// Cost of a tile from where the goal can't be reached
+static const int Unreachable = INT_MAX;
+/// Steps of a tile from where the goal can't be reached
+static const int NoSteps = -1;
+
+/**
+**  What a flow field leads to.
+*/
+class FlowFieldGoal
+{
+public:
+	FlowFieldGoal(const Vec2i &pos, int gw, int gh, int minrange, int maxrange, int mask, int player) :
+		Pos(pos), Size(gw, gh), MinRange(minrange), MaxRange(maxrange), Mask(mask), Player(player) {}
+
+	bool operator == (const FlowFieldGoal &rhs) const {
+		return Pos == rhs.Pos && Size == rhs.Size && MinRange == rhs.MinRange
+			   && MaxRange == rhs.MaxRange && Mask == rhs.Mask && Player == rhs.Player;
+	}
+
+public:
+	Vec2i Pos;     /// Top left tile of the goal
+	Vec2i Size;    /// Size of the goal
+	int MinRange;  /// Min range to the goal
+	int MaxRange;  /// Max range to the goal
+	int Mask;      /// Static part of the movement mask
+	int Player;    /// Player whose explored tiles are known, -1 for the whole map
+};
+
+/**
+**  Cost and direction to the goal from each tile of the map.
+*/
+class CFlowField
+{
+public:
+	explicit CFlowField(const FlowFieldGoal &goal) :
+		Goal(goal), LastUsedCycle(GameCycle), Outdated(false) {}
+
+	void Compute();
+	bool IsInvalidatedBy(unsigned int index) const;
+	int GetPath(const Vec2i &startPos, char *path, int pathlen);
+
+private:
+	bool IsBlocked(unsigned int index) const;
+	int GetEnterCost(unsigned int index) const;
+
+public:
+	FlowFieldGoal Goal;             /// Goal of the field
+	unsigned long LastUsedCycle;    /// Last cycle a unit used the field
+	bool Outdated;                  /// A path goes through a blocked tile
+private:
+	std::vector<int> Steps;         /// Number of steps to reach the goal, -1 if unreachable
+	std::vector<char> Directions;   /// Next step from each tile, -1 for none
+};
+
+/**
+**  Units which recently asked for a path to a goal.
+*/
+struct FlowFieldRequest {
+	FlowFieldRequest(const FlowFieldGoal &goal) : Goal(goal), Count(0), Cycle(GameCycle) {}
+
+	FlowFieldGoal Goal;   /// Goal of the requests
+	int Count;            /// Number of requests
+	unsigned long Cycle;  /// Cycle of the first request
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+/// Fields in use
+static std::vector<CFlowField *> FlowFields;
+/// Recent requests for goals without field
+static std::vector<FlowFieldRequest> FlowFieldRequests;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Check if a tile can't be entered, as known by the player of the field.
+*/
+bool CFlowField::IsBlocked(unsigned int index) const
+{
+	return Map.CheckMask(index, Goal.Mask)
+		   && (Goal.Player == -1 || Map.Field(index)->IsExplored(Goal.Player));
+}
+
+/**
+**  Cost to enter a tile, as in AStarFindPath.
+*/
+int CFlowField::GetEnterCost(unsigned int index) const
+{
+	const CMapField &mf = *Map.Field(index);
+
+	if (Goal.Player != -1 && !mf.IsExplored(Goal.Player)) {
+		return 1 + mf.Cost + AStarUnknownTerrainCost;
+	}
+	return 1 + mf.Cost;
+}
+
+/**
+**  Compute the cost to the goal from every tile, starting from the goal.
+**
+**  Only the steps and directions are kept, the costs are only needed
+**  while the field is computed.
+*/
+void CFlowField::Compute()
+{
+	const unsigned int size = Map.Info.MapWidth * Map.Info.MapHeight;
+	typedef std::pair<int, unsigned int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+	std::vector<unsigned int> goalTiles;
+	std::vector<int> costs(size, Unreachable);
+
+	Steps.assign(size, NoSteps);
+	Directions.assign(size, -1);
+
+	AStarGetGoalTiles(Goal.Pos, Goal.Size.x, Goal.Size.y, 1, 1, Goal.MinRange, Goal.MaxRange, goalTiles);
+	for (size_t i = 0; i != goalTiles.size(); ++i) {
+		const unsigned int index = goalTiles[i];
+
+		if (!IsBlocked(index) && costs[index] != 0) {
+			costs[index] = 0;
+			Steps[index] = 0;
+			open.push(Entry(0, index));
+		}
+	}
+	while (!open.empty()) {
+		const int cost = open.top().first;
+		const unsigned int index = open.top().second;
+		open.pop();
+
+		if (cost != costs[index]) {
+			continue;
+		}
+		const Vec2i pos(index % Map.Info.MapWidth, index / Map.Info.MapWidth);
+		// Cost for a unit of the neighbour tile to enter this one.
+		const int newCost = cost + GetEnterCost(index);
+
+		for (int i = 0; i < 8; ++i) {
+			const Vec2i newPos(pos.x - Heading2X[i], pos.y - Heading2Y[i]);
+
+			if (!Map.Info.IsPointOnMap(newPos)) {
+				continue;
+			}
+			const unsigned int newIndex = Map.getIndex(newPos);
+			if (newCost < costs[newIndex] && !IsBlocked(newIndex)) {
+				costs[newIndex] = newCost;
+				Steps[newIndex] = Steps[index] + 1;
+				Directions[newIndex] = i;
+				open.push(Entry(newCost, newIndex));
+			}
+		}
+	}
+}
+
+/**
+**  Check if a tile which became blocked is used by the field.
+*/
+bool CFlowField::IsInvalidatedBy(unsigned int index) const
+{
+	return Steps[index] != NoSteps && IsBlocked(index);
+}
+
+/**
+**  Follow the field from a tile.
+**
+**  @param startPos  Start of the path.
+**  @param path      Filled with the first steps of the path, as AStarFindPath.
+**  @param pathlen   Size of path.
+**
+**  @return          The length of the whole path, or the pathfinder error.
+*/
+int CFlowField::GetPath(const Vec2i &startPos, char *path, int pathlen)
+{
+	unsigned int index = Map.getIndex(startPos);
+
+	const int length = Steps[index];
+
+	if (length == NoSteps) {
+		// Blocked start tile, let the other pathfinders decide.
+		return IsBlocked(index) ? PF_FAILED : PF_UNREACHABLE;
+	}
+	if (length == 0) {
+		return PF_REACHED;
+	}
+	const int pathLength = std::min(length, pathlen);
+	Vec2i pos = startPos;
+	for (int i = 0; i != pathLength; ++i) {
+		const int direction = Directions[index];
+
+		path[pathLength - i - 1] = direction;
+		pos.x += Heading2X[direction];
+		pos.y += Heading2Y[direction];
+		index = Map.getIndex(pos);
+		// The player has discovered an obstacle on the way.
+		if (IsBlocked(index)) {
+			Outdated = true;
+			return PF_FAILED;
+		}
+	}
+	return length;
+}
+
+/**
+**  Find or make the field for a goal.
+**
+**  @return  The field, NULL if not enough units go to this goal.
+*/
+static CFlowField *GetFlowField(const FlowFieldGoal &goal)
+{
+	// Free the old fields.
+	for (size_t i = 0; i != FlowFields.size();) {
+		if (FlowFields[i]->Outdated || FlowFields[i]->LastUsedCycle + FlowFieldKeepCycles < GameCycle) {
+			delete FlowFields[i];
+			FlowFields.erase(FlowFields.begin() + i);
+		} else {
+			++i;
+		}
+	}
+	for (size_t i = 0; i != FlowFields.size(); ++i) {
+		if (FlowFields[i]->Goal == goal) {
+			FlowFields[i]->LastUsedCycle = GameCycle;
+			return FlowFields[i];
+		}
+	}
+
+	// Units of a group don't all ask in the same cycle, they end their
+	// current step first.
+	std::vector<FlowFieldRequest>::iterator it = FlowFieldRequests.begin();
+	while (it != FlowFieldRequests.end()) {
+		if (it->Cycle + FlowFieldRequestCycles < GameCycle) {
+			it = FlowFieldRequests.erase(it);
+		} else if (it->Goal == goal) {
+			break;
+		} else {
+			++it;
+		}
+	}
+	if (it == FlowFieldRequests.end()) {
+		FlowFieldRequests.push_back(FlowFieldRequest(goal));
+		it = FlowFieldRequests.end() - 1;
+	}
+	if (++it->Count < FlowFieldMinUnits) {
+		return NULL;
+	}
+	FlowFieldRequests.erase(it);
+
+	if (FlowFields.size() == FlowFieldMaxCount) {
+		size_t oldest = 0;
+		for (size_t i = 1; i != FlowFields.size(); ++i) {
+			if (FlowFields[i]->LastUsedCycle < FlowFields[oldest]->LastUsedCycle) {
+				oldest = i;
+			}
+		}
+		delete FlowFields[oldest];
+		FlowFields.erase(FlowFields.begin() + oldest);
+	}
+	CFlowField *field = new CFlowField(goal);
+	field->Compute();
+	FlowFields.push_back(field);
+	return field;
+}
+
+/**
+**  Find a path for a unit in a group going to the same goal.
+**
+**  @return  Same as AStarFindPath, PF_FAILED when no field is shared.
+*/
+int FlowFieldFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+					  int tilesizex, int tilesizey, int minrange, int maxrange,
+					  char *path, int pathlen, const CUnit &unit)
+{
+	const int mask = unit.Type->MovementMask & ~UnitFieldFlags;
+
+	// The field don't know about the size of the units, and flying
+	// units have nothing static in their way.
+	if (path == NULL || tilesizex != 1 || tilesizey != 1 || mask == 0) {
+		return PF_FAILED;
+	}
+	const Vec2i goalBottomRight(goalPos.x + std::max(gw, 1) - 1, goalPos.y + std::max(gh, 1) - 1);
+	const int dx = std::max(goalPos.x - startPos.x, startPos.x - goalBottomRight.x);
+	const int dy = std::max(goalPos.y - startPos.y, startPos.y - goalBottomRight.y);
+	if (std::max(dx, dy) - maxrange < FlowFieldMinDistance) {
+		return PF_FAILED;
+	}
+	// Without knowledge of the map, the unexplored tiles are as in AStarFindPath.
+	const int player = AStarKnowUnseenTerrain ? -1 : unit.Player->Index;
+	CFlowField *field = GetFlowField(FlowFieldGoal(goalPos, gw, gh, minrange, maxrange, mask, player));
+
+	if (field == NULL) {
+		return PF_FAILED;
+	}
+	return field->GetPath(startPos, path, pathlen);
+}
+
+/**
+**  Free the fields which go through a tile which became blocked.
+*/
+void FlowFieldTileChanged(const Vec2i &pos)
+{
+	const unsigned int index = Map.getIndex(pos);
+
+	for (size_t i = 0; i != FlowFields.size();) {
+		if (FlowFields[i]->IsInvalidatedBy(index)) {
+			delete FlowFields[i];
+			FlowFields.erase(FlowFields.begin() + i);
+		} else {
+			++i;
+		}
+	}
+}
+
+/**
+**  Free all the fields.
+*/
+void FreeFlowFields()
+{
+	for (size_t i = 0; i != FlowFields.size(); ++i) {
+		delete FlowFields[i];
+	}
+	FlowFields.clear();
+	FlowFieldRequests.clear();
+}
+
+//@}
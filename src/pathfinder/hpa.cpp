@@ -0,0 +1,679 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name hpa.cpp - The hierarchical path finder routines. */
+//
+//      The map is cut in square clusters. Tiles on both sides of a
+//      cluster border where a unit can cross are linked together
+//      (transitions), and the nodes of a same cluster are linked by their
+//      shortest path inside the cluster. A long query is first solved on
+//      this small abstract graph, then refined with A* one abstract node
+//      at a time, only as far as the caller needs it.
+//
+//      The abstract graph only knows about static obstacles (terrain,
+//      walls, buildings), moving units are left to the refining A*.
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "pathfinder.h"
+
+#include "map.h"
+#include "player.h"
+#include "unit.h"
+#include "unittype.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits.h>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/// Find and a* path for a unit (astar.cpp)
+extern int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+						 int tilesizex, int tilesizey, int minrange,
+						 int maxrange, char *path, int pathlen, const CUnit &unit);
+
+/// Size in tiles of a cluster side
+static const int ClusterSize = 16;
+/// Entrances at least this long get a transition at each end
+static const int LongEntranceLength = 6;
+/// Under this distance to the goal, a plain A* is used
+static const int HierarchicalMinDistance = 2 * ClusterSize;
+/// Unit flags, they are not static obstacles
+static const int UnitFieldFlags = MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit;
+/// Distance of a tile not reached
+static const int Unreachable = INT_MAX;
+
+/// Edge between two nodes of a same cluster
+struct AbstractEdge {
+	AbstractEdge(int to, int cost) : To(to), Cost(cost) {}
+
+	int To;    /// Destination node
+	int Cost;  /// Cost of the shortest path inside the cluster
+};
+
+/// Node of the abstract graph : a tile along a cluster border
+struct AbstractNode {
+	AbstractNode() : Cluster(-1), Partner(-1) {}
+
+	Vec2i Pos;                        /// Tile of the node
+	int Cluster;                      /// Cluster containing the tile
+	int Partner;                      /// Node on the other side of the border, -1 for a free slot
+	std::vector<AbstractEdge> Edges;  /// Edges to the nodes of the same cluster
+};
+
+/// Square part of the map
+struct AbstractCluster {
+	AbstractCluster() : Dirty(false) {}
+
+	std::vector<int> Nodes;  /// Nodes of the cluster
+	bool Dirty;              /// Edges must be recomputed
+};
+
+/**
+**  Abstract graph of the map for one movement mask.
+**
+**  Borders are numbered 2 * cluster for the one on the right of the
+**  cluster and 2 * cluster + 1 for the one below.
+*/
+class CAbstractLayer
+{
+public:
+	explicit CAbstractLayer(int mask) : Mask(mask & ~UnitFieldFlags), Width(0), Height(0) {}
+
+	void Init();
+	void MarkChanged(const Vec2i &pos);
+	void Update();
+
+	int FindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+				 int minrange, int maxrange, char *path, int pathlen, const CUnit &unit);
+
+	int GetMask() const { return Mask; }
+
+private:
+	bool IsPassable(const Vec2i &pos) const { return (Map.Field(pos)->Flags & Mask) == 0; }
+	int GetClusterIndex(const Vec2i &pos) const { return pos.y / ClusterSize * Width + pos.x / ClusterSize; }
+	void GetClusterArea(int cluster, Vec2i &topLeft, Vec2i &bottomRight) const;
+
+	void MarkBorderDirty(int border);
+	void MarkClusterDirty(int cluster);
+	void BuildBorder(int border);
+	void AddTransition(int border, const Vec2i &pos1, const Vec2i &pos2);
+	void BuildClusterEdges(int cluster);
+	void ClusterDistances(int cluster, const std::vector<Vec2i> &seeds, std::vector<int> &dist) const;
+
+private:
+	int Mask;                                  /// Static part of the movement mask
+	int Width;                                 /// Number of clusters in a row
+	int Height;                                /// Number of clusters in a column
+	std::vector<AbstractCluster> Clusters;     /// All clusters
+	std::vector<AbstractNode> Nodes;           /// All nodes, free slots included
+	std::vector<int> FreeNodes;                /// Free slots in Nodes
+	std::vector<std::vector<int> > Borders;    /// Nodes created by each border
+	std::vector<char> BorderDirty;             /// Border must be rebuilt
+	std::vector<int> DirtyBorders;             /// Borders to rebuild
+	std::vector<int> DirtyClusters;            /// Clusters whose edges must be recomputed
+};
+
+/// heuristic cost function for the abstract a*
+static inline int AbstractCosts(const Vec2i &pos, const Vec2i &goalPos)
+{
+	return std::max<int>(abs(pos.x - goalPos.x), abs(pos.y - goalPos.y));
+}
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+/// One abstract graph for each movement mask in use
+static std::vector<CAbstractLayer> AbstractLayers;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Get the tiles covered by a cluster.
+*/
+void CAbstractLayer::GetClusterArea(int cluster, Vec2i &topLeft, Vec2i &bottomRight) const
+{
+	topLeft.x = (cluster % Width) * ClusterSize;
+	topLeft.y = (cluster / Width) * ClusterSize;
+	bottomRight.x = std::min(topLeft.x + ClusterSize, Map.Info.MapWidth) - 1;
+	bottomRight.y = std::min(topLeft.y + ClusterSize, Map.Info.MapHeight) - 1;
+}
+
+/**
+**  Build the whole abstract graph.
+*/
+void CAbstractLayer::Init()
+{
+	Width = (Map.Info.MapWidth + ClusterSize - 1) / ClusterSize;
+	Height = (Map.Info.MapHeight + ClusterSize - 1) / ClusterSize;
+
+	Clusters.assign(Width * Height, AbstractCluster());
+	Nodes.clear();
+	FreeNodes.clear();
+	Borders.assign(2 * Width * Height, std::vector<int>());
+	BorderDirty.assign(2 * Width * Height, 0);
+	DirtyBorders.clear();
+	DirtyClusters.clear();
+
+	for (int i = 0; i != 2 * Width * Height; ++i) {
+		MarkBorderDirty(i);
+	}
+	Update();
+}
+
+void CAbstractLayer::MarkBorderDirty(int border)
+{
+	const int cluster = border / 2;
+
+	// Last column has no right border, last row has no bottom border.
+	if ((border & 1) == 0 && cluster % Width == Width - 1) {
+		return;
+	}
+	if ((border & 1) == 1 && cluster / Width == Height - 1) {
+		return;
+	}
+	if (!BorderDirty[border]) {
+		BorderDirty[border] = 1;
+		DirtyBorders.push_back(border);
+	}
+}
+
+void CAbstractLayer::MarkClusterDirty(int cluster)
+{
+	if (!Clusters[cluster].Dirty) {
+		Clusters[cluster].Dirty = true;
+		DirtyClusters.push_back(cluster);
+	}
+}
+
+/**
+**  Passability of a tile has changed.
+**  Its cluster and the borders it lies on are rebuilt at next query.
+*/
+void CAbstractLayer::MarkChanged(const Vec2i &pos)
+{
+	const int cluster = GetClusterIndex(pos);
+	const Vec2i local(pos.x % ClusterSize, pos.y % ClusterSize);
+
+	MarkClusterDirty(cluster);
+	if (local.x == 0 && pos.x != 0) {
+		MarkBorderDirty(2 * (cluster - 1));
+	}
+	if (local.x == ClusterSize - 1) {
+		MarkBorderDirty(2 * cluster);
+	}
+	if (local.y == 0 && pos.y != 0) {
+		MarkBorderDirty(2 * (cluster - Width) + 1);
+	}
+	if (local.y == ClusterSize - 1) {
+		MarkBorderDirty(2 * cluster + 1);
+	}
+}
+
+/**
+**  Rebuild the borders and clusters which have changed.
+*/
+void CAbstractLayer::Update()
+{
+	for (size_t i = 0; i != DirtyBorders.size(); ++i) {
+		BuildBorder(DirtyBorders[i]);
+		BorderDirty[DirtyBorders[i]] = 0;
+	}
+	DirtyBorders.clear();
+	for (size_t i = 0; i != DirtyClusters.size(); ++i) {
+		BuildClusterEdges(DirtyClusters[i]);
+		Clusters[DirtyClusters[i]].Dirty = false;
+	}
+	DirtyClusters.clear();
+}
+
+/**
+**  Add a transition across a border : one node on each side.
+*/
+void CAbstractLayer::AddTransition(int border, const Vec2i &pos1, const Vec2i &pos2)
+{
+	int ids[2];
+	const Vec2i pos[2] = {pos1, pos2};
+
+	for (int i = 0; i != 2; ++i) {
+		if (FreeNodes.empty()) {
+			ids[i] = Nodes.size();
+			Nodes.push_back(AbstractNode());
+		} else {
+			ids[i] = FreeNodes.back();
+			FreeNodes.pop_back();
+		}
+		AbstractNode &node = Nodes[ids[i]];
+		node.Pos = pos[i];
+		node.Cluster = GetClusterIndex(pos[i]);
+		node.Edges.clear();
+		Clusters[node.Cluster].Nodes.push_back(ids[i]);
+		Borders[border].push_back(ids[i]);
+	}
+	Nodes[ids[0]].Partner = ids[1];
+	Nodes[ids[1]].Partner = ids[0];
+}
+
+/**
+**  Compute the transitions of a border.
+**
+**  Each run of tiles passable on both sides gives one transition in its
+**  middle, or one at each end when it is long.
+*/
+void CAbstractLayer::BuildBorder(int border)
+{
+	// Remove the old nodes.
+	std::vector<int> &borderNodes = Borders[border];
+	for (size_t i = 0; i != borderNodes.size(); ++i) {
+		AbstractNode &node = Nodes[borderNodes[i]];
+		std::vector<int> &clusterNodes = Clusters[node.Cluster].Nodes;
+
+		clusterNodes.erase(std::find(clusterNodes.begin(), clusterNodes.end(), borderNodes[i]));
+		MarkClusterDirty(node.Cluster);
+		node.Cluster = -1;
+		node.Partner = -1;
+		node.Edges.clear();
+		FreeNodes.push_back(borderNodes[i]);
+	}
+	borderNodes.clear();
+
+	const int cluster = border / 2;
+	const bool vertical = (border & 1) == 0;
+	Vec2i topLeft;
+	Vec2i bottomRight;
+	GetClusterArea(cluster, topLeft, bottomRight);
+
+	// pos walks along the border inside the cluster, pos + step is outside.
+	const Vec2i step(vertical ? 1 : 0, vertical ? 0 : 1);
+	const Vec2i dir(vertical ? 0 : 1, vertical ? 1 : 0);
+	const Vec2i start(vertical ? bottomRight.x : topLeft.x, vertical ? topLeft.y : bottomRight.y);
+	const int length = vertical ? bottomRight.y - topLeft.y + 1 : bottomRight.x - topLeft.x + 1;
+
+	MarkClusterDirty(cluster);
+	MarkClusterDirty(GetClusterIndex(start + step));
+
+	int runStart = -1;
+	for (int i = 0; i <= length; ++i) {
+		const Vec2i pos(start.x + dir.x * i, start.y + dir.y * i);
+		const bool open = i < length && IsPassable(pos) && IsPassable(pos + step);
+
+		if (open && runStart == -1) {
+			runStart = i;
+		} else if (!open && runStart != -1) {
+			const int runLength = i - runStart;
+			const Vec2i first(start.x + dir.x * runStart, start.y + dir.y * runStart);
+
+			if (runLength < LongEntranceLength) {
+				const Vec2i middle(first.x + dir.x * (runLength / 2), first.y + dir.y * (runLength / 2));
+				AddTransition(border, middle, middle + step);
+			} else {
+				const Vec2i last(first.x + dir.x * (runLength - 1), first.y + dir.y * (runLength - 1));
+				AddTransition(border, first, first + step);
+				AddTransition(border, last, last + step);
+			}
+			runStart = -1;
+		}
+	}
+}
+
+/**
+**  Compute the costs to reach each tile of a cluster from a set of tiles,
+**  moving only inside the cluster.
+**
+**  @param cluster  Cluster to explore.
+**  @param seeds    Starting tiles, at cost 0.
+**  @param dist     Filled with the cost of each tile of the cluster, row by row.
+*/
+void CAbstractLayer::ClusterDistances(int cluster, const std::vector<Vec2i> &seeds, std::vector<int> &dist) const
+{
+	typedef std::pair<int, int> Entry; // cost, local index
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+	Vec2i topLeft;
+	Vec2i bottomRight;
+	GetClusterArea(cluster, topLeft, bottomRight);
+
+	dist.assign(ClusterSize * ClusterSize, Unreachable);
+	for (size_t i = 0; i != seeds.size(); ++i) {
+		const int index = (seeds[i].y - topLeft.y) * ClusterSize + seeds[i].x - topLeft.x;
+		if (dist[index] != 0) {
+			dist[index] = 0;
+			open.push(Entry(0, index));
+		}
+	}
+	while (!open.empty()) {
+		const Entry entry = open.top();
+		open.pop();
+		if (entry.first != dist[entry.second]) {
+			continue;
+		}
+		const Vec2i pos(topLeft.x + entry.second % ClusterSize, topLeft.y + entry.second / ClusterSize);
+
+		for (int i = 0; i < 8; ++i) {
+			const Vec2i newPos(pos.x + Heading2X[i], pos.y + Heading2Y[i]);
+
+			if (newPos.x < topLeft.x || newPos.x > bottomRight.x
+				|| newPos.y < topLeft.y || newPos.y > bottomRight.y
+				|| !IsPassable(newPos)) {
+				continue;
+			}
+			// Same cost as A* : one for the move plus the tile cost.
+			const int cost = entry.first + 1 + Map.Field(newPos)->Cost;
+			const int index = (newPos.y - topLeft.y) * ClusterSize + newPos.x - topLeft.x;
+			if (cost < dist[index]) {
+				dist[index] = cost;
+				open.push(Entry(cost, index));
+			}
+		}
+	}
+}
+
+/**
+**  Link all the nodes of a cluster by their shortest path inside it.
+*/
+void CAbstractLayer::BuildClusterEdges(int cluster)
+{
+	const std::vector<int> &clusterNodes = Clusters[cluster].Nodes;
+	Vec2i topLeft;
+	Vec2i bottomRight;
+	GetClusterArea(cluster, topLeft, bottomRight);
+
+	std::vector<Vec2i> seeds(1);
+	std::vector<int> dist;
+	for (size_t i = 0; i != clusterNodes.size(); ++i) {
+		AbstractNode &node = Nodes[clusterNodes[i]];
+
+		node.Edges.clear();
+		seeds[0] = node.Pos;
+		ClusterDistances(cluster, seeds, dist);
+		for (size_t j = 0; j != clusterNodes.size(); ++j) {
+			const Vec2i &pos = Nodes[clusterNodes[j]].Pos;
+			const int cost = dist[(pos.y - topLeft.y) * ClusterSize + pos.x - topLeft.x];
+
+			if (i != j && cost != Unreachable) {
+				node.Edges.push_back(AbstractEdge(clusterNodes[j], cost));
+			}
+		}
+	}
+}
+
+/**
+**  Find a path on the abstract graph and refine its beginning with A*.
+**
+**  @return  PF_FAILED if the abstract graph can't help, else as AStarFindPath.
+*/
+int CAbstractLayer::FindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+							 int minrange, int maxrange, char *path, int pathlen, const CUnit &unit)
+{
+	Update();
+
+	const Vec2i goalCenter(goalPos.x + std::max(gw, 1) / 2, goalPos.y + std::max(gh, 1) / 2);
+	const int startCluster = GetClusterIndex(startPos);
+	const int goalCluster = GetClusterIndex(goalCenter);
+	if (startCluster == goalCluster) {
+		return PF_FAILED;
+	}
+
+	// Costs from the start to the tiles of its cluster.
+	std::vector<Vec2i> seeds(1, startPos);
+	std::vector<int> startDist;
+	ClusterDistances(startCluster, seeds, startDist);
+
+	// Costs from the tiles of the goal cluster to the goal area.
+	Vec2i goalTopLeft;
+	Vec2i goalBottomRight;
+	GetClusterArea(goalCluster, goalTopLeft, goalBottomRight);
+	const Vec2i areaMin(std::max<int>(goalTopLeft.x, goalPos.x - maxrange - 1),
+						std::max<int>(goalTopLeft.y, goalPos.y - maxrange - 1));
+	const Vec2i areaMax(std::min<int>(goalBottomRight.x, goalPos.x + std::max(gw, 1) + maxrange),
+						std::min<int>(goalBottomRight.y, goalPos.y + std::max(gh, 1) + maxrange));
+	seeds.clear();
+	for (Vec2i pos = areaMin; pos.y <= areaMax.y; ++pos.y) {
+		for (pos.x = areaMin.x; pos.x <= areaMax.x; ++pos.x) {
+			if (IsPassable(pos)) {
+				seeds.push_back(pos);
+			}
+		}
+	}
+	if (seeds.empty()) {
+		return PF_FAILED;
+	}
+	std::vector<int> goalDist;
+	ClusterDistances(goalCluster, seeds, goalDist);
+
+	// A* on the abstract graph, the goal is an extra node.
+	typedef std::pair<int, int> Entry; // estimated cost, node
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+	const int goalNode = Nodes.size();
+	std::vector<int> costs(goalNode + 1, Unreachable);
+	std::vector<int> parents(goalNode + 1, -1);
+	std::vector<char> closed(goalNode + 1, 0);
+
+	Vec2i topLeft;
+	Vec2i bottomRight;
+	GetClusterArea(startCluster, topLeft, bottomRight);
+	const std::vector<int> &startNodes = Clusters[startCluster].Nodes;
+	for (size_t i = 0; i != startNodes.size(); ++i) {
+		const Vec2i &pos = Nodes[startNodes[i]].Pos;
+		const int cost = startDist[(pos.y - topLeft.y) * ClusterSize + pos.x - topLeft.x];
+
+		if (cost != Unreachable) {
+			costs[startNodes[i]] = cost;
+			open.push(Entry(cost + AbstractCosts(pos, goalCenter), startNodes[i]));
+		}
+	}
+	while (!open.empty()) {
+		const int current = open.top().second;
+		open.pop();
+		if (closed[current]) {
+			continue;
+		}
+		closed[current] = 1;
+		if (current == goalNode) {
+			break;
+		}
+		const AbstractNode &node = Nodes[current];
+		const int cost = costs[current];
+
+		// Cross the border.
+		const AbstractNode &partner = Nodes[node.Partner];
+		const int partnerCost = cost + 1 + Map.Field(partner.Pos)->Cost;
+		if (partnerCost < costs[node.Partner]) {
+			costs[node.Partner] = partnerCost;
+			parents[node.Partner] = current;
+			open.push(Entry(partnerCost + AbstractCosts(partner.Pos, goalCenter), node.Partner));
+		}
+		// Move inside the cluster.
+		for (size_t i = 0; i != node.Edges.size(); ++i) {
+			const AbstractEdge &edge = node.Edges[i];
+			const int newCost = cost + edge.Cost;
+
+			if (newCost < costs[edge.To]) {
+				costs[edge.To] = newCost;
+				parents[edge.To] = current;
+				open.push(Entry(newCost + AbstractCosts(Nodes[edge.To].Pos, goalCenter), edge.To));
+			}
+		}
+		// Reach the goal.
+		if (node.Cluster == goalCluster) {
+			const int dist = goalDist[(node.Pos.y - goalTopLeft.y) * ClusterSize + node.Pos.x - goalTopLeft.x];
+			if (dist != Unreachable && cost + dist < costs[goalNode]) {
+				costs[goalNode] = cost + dist;
+				parents[goalNode] = current;
+				open.push(Entry(cost + dist, goalNode));
+			}
+		}
+	}
+	if (!closed[goalNode]) {
+		// Maybe reachable through units or outside the goal cluster, let A* decide.
+		return PF_FAILED;
+	}
+
+	std::vector<int> waypoints;
+	for (int i = parents[goalNode]; i != -1; i = parents[i]) {
+		waypoints.push_back(i);
+	}
+	std::reverse(waypoints.begin(), waypoints.end());
+
+	// A waypoint taken by a unit fails its refinement, don't refine the
+	// waypoints before it for nothing.
+	for (size_t i = 0; i != waypoints.size(); ++i) {
+		const Vec2i &waypoint = Nodes[waypoints[i]].Pos;
+
+		if (waypoint != startPos && !CanMoveToMask(waypoint, unit.Type->MovementMask)) {
+			return PF_FAILED;
+		}
+	}
+
+	// Refine with A* until we have enough steps.
+	std::vector<char> steps;
+	std::vector<char> buffer(pathlen);
+	Vec2i pos = startPos;
+	int remainingLength = 0;
+	size_t i = 0;
+	for (; i != waypoints.size() && (int)steps.size() < pathlen; ++i) {
+		const Vec2i &waypoint = Nodes[waypoints[i]].Pos;
+		const int length = AStarFindPath(pos, waypoint, 0, 0, 1, 1, 0, 0, &buffer[0], pathlen, unit);
+
+		if (length == PF_REACHED) {
+			continue;
+		}
+		if (length < 0) {
+			return PF_FAILED;
+		}
+		for (int j = std::min(length, pathlen); j--;) {
+			steps.push_back(buffer[j]);
+		}
+		pos = waypoint;
+		remainingLength = std::max(0, length - pathlen);
+	}
+	if (i == waypoints.size() && (int)steps.size() < pathlen) {
+		// Last part, to the real goal.
+		const int length = AStarFindPath(pos, goalPos, gw, gh, 1, 1, minrange, maxrange,
+										 &buffer[0], pathlen, unit);
+		if (length != PF_REACHED) {
+			if (length < 0) {
+				return PF_FAILED;
+			}
+			for (int j = std::min(length, pathlen); j--;) {
+				steps.push_back(buffer[j]);
+			}
+			remainingLength = std::max(0, length - pathlen);
+		}
+	} else {
+		// Estimate the length of the part not refined.
+		for (; i != waypoints.size(); ++i) {
+			remainingLength += AbstractCosts(pos, Nodes[waypoints[i]].Pos);
+			pos = Nodes[waypoints[i]].Pos;
+		}
+		remainingLength += AbstractCosts(pos, goalCenter);
+	}
+
+	// Save the beginning of the path, as AStarSavePath does.
+	const int pathLength = std::min<int>(steps.size(), pathlen);
+	for (int j = 0; j != pathLength; ++j) {
+		path[pathLength - j - 1] = steps[j];
+	}
+	return steps.size() + remainingLength;
+}
+
+/**
+**  Init the abstract graphs, one for each movement mask.
+*/
+void InitHierarchicalPathfinder(const std::vector<int> &masks)
+{
+	AbstractLayers.clear();
+	for (size_t i = 0; i != masks.size(); ++i) {
+		AbstractLayers.push_back(CAbstractLayer(masks[i]));
+		AbstractLayers.back().Init();
+	}
+}
+
+/**
+**  Free the abstract graphs.
+*/
+void FreeHierarchicalPathfinder()
+{
+	AbstractLayers.clear();
+}
+
+/**
+**  Find a path using the abstract graph.
+**
+**  Only long paths for units of one tile are handled, and only when the
+**  path is requested. The graph knows the whole map, so like the regions
+**  it is only used when the unit may know the unseen terrain.
+**
+**  @return  PF_FAILED if a plain A* must be used, else as AStarFindPath.
+*/
+int HierarchicalFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+						 int tilesizex, int tilesizey, int minrange, int maxrange,
+						 char *path, int pathlen, const CUnit &unit)
+{
+	if (path == NULL || pathlen <= 0 || tilesizex != 1 || tilesizey != 1) {
+		return PF_FAILED;
+	}
+	if (!AStarKnowUnseenTerrain && !unit.Player->AiEnabled) {
+		return PF_FAILED;
+	}
+	const Vec2i goalBottomRight(goalPos.x + std::max(gw, 1) - 1, goalPos.y + std::max(gh, 1) - 1);
+	const int dx = std::max(goalPos.x - startPos.x, startPos.x - goalBottomRight.x);
+	const int dy = std::max(goalPos.y - startPos.y, startPos.y - goalBottomRight.y);
+	if (std::max(dx, dy) - maxrange < HierarchicalMinDistance) {
+		return PF_FAILED;
+	}
+
+	const int mask = unit.Type->MovementMask & ~UnitFieldFlags;
+	for (size_t i = 0; i != AbstractLayers.size(); ++i) {
+		if (AbstractLayers[i].GetMask() == mask) {
+			return AbstractLayers[i].FindPath(startPos, goalPos, gw, gh, minrange, maxrange,
+											  path, pathlen, unit);
+		}
+	}
+	return PF_FAILED;
+}
+
+/**
+**  Static passability of a tile has changed.
+*/
+void HierarchicalTileChanged(const Vec2i &pos)
+{
+	for (size_t i = 0; i != AbstractLayers.size(); ++i) {
+		AbstractLayers[i].MarkChanged(pos);
+	}
+}
+
+//@}
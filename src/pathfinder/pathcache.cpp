@@ -0,0 +1,363 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name pathcache.cpp - Paths shared by units asking the same query. */
+//
+//      Units going back and forth between the same places (harvesters)
+//      ask again and again for the same path. The last paths found are
+//      kept by start region and goal, and a unit standing on or next to
+//      one of them gets the rest of it instead of running a new search.
+//      A path is forgotten when the passability of one of its tiles
+//      changes.
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "pathfinder.h"
+
+#include "map.h"
+#include "player.h"
+#include "unit.h"
+#include "unittype.h"
+
+#include <algorithm>
+#include <list>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/// Max number of paths kept
+static const size_t PathCacheMaxCount = 64;
+/// Unit flags, they are not static obstacles
+static const int UnitFieldFlags = MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit;
+
+/**
+**  What a path has been searched for.
+**
+**  Paths from anywhere in the start region are kept together, the
+**  tiles of the path tell if a unit can follow one.
+*/
+class PathCacheQuery
+{
+public:
+	PathCacheQuery(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+				   int tilesizex, int tilesizey, int minrange, int maxrange, const CUnit &unit) :
+		StartRegion(GetMapRegion(unit.Type->MovementMask, Map.getIndex(startPos))),
+		GoalPos(goalPos), GoalSize(gw, gh), UnitSize(tilesizex, tilesizey),
+		MinRange(minrange), MaxRange(maxrange), Mask(unit.Type->MovementMask & ~UnitFieldFlags),
+		Player(AStarKnowUnseenTerrain ? -1 : unit.Player->Index) {}
+
+	bool operator == (const PathCacheQuery &rhs) const {
+		return StartRegion == rhs.StartRegion && IsSameGoal(rhs);
+	}
+
+	/// Same query, whatever the start
+	bool IsSameGoal(const PathCacheQuery &rhs) const {
+		return GoalPos == rhs.GoalPos && GoalSize == rhs.GoalSize
+			   && UnitSize == rhs.UnitSize && MinRange == rhs.MinRange && MaxRange == rhs.MaxRange
+			   && Mask == rhs.Mask && Player == rhs.Player;
+	}
+
+public:
+	int StartRegion; /// Region of the start tile, 0 if unknown
+	Vec2i GoalPos;   /// Top left tile of the goal
+	Vec2i GoalSize;  /// Size of the goal
+	Vec2i UnitSize;  /// Size of the unit
+	int MinRange;    /// Min range to the goal
+	int MaxRange;    /// Max range to the goal
+	int Mask;        /// Static part of the movement mask
+	int Player;      /// Player whose explored tiles are known, -1 for the whole map
+};
+
+/**
+**  A path found for a query.
+*/
+struct PathCacheEntry {
+	PathCacheEntry(const PathCacheQuery &query, unsigned int exploreEpoch) :
+		Query(query), ExploreEpoch(exploreEpoch) {}
+
+	void SetPath(const Vec2i &startPos, const char *path, int length);
+	int FindTile(const Vec2i &pos, int *direction) const;
+	bool Crosses(const Vec2i &pos, int w, int h) const;
+
+	PathCacheQuery Query;    /// Query of the path
+	unsigned int ExploreEpoch; /// Explore epoch of the player when the path was found
+	std::vector<char> Path;  /// Directions of the path, first one at the end
+	std::vector<Vec2i> Tiles; /// Tiles of the path, the start first
+	Vec2i MinPos;            /// Top left tile covered by the unit on the path
+	Vec2i MaxPos;            /// Bottom right tile covered by the unit on the path
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+/// Paths kept, the most recently used first
+static std::list<PathCacheEntry> PathCache;
+/// Bumped each time a player explores a tile
+static unsigned int PathCacheExploreEpochs[PlayerMax];
+/// Hits and misses of the cache
+static PathCacheCounters Counters;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Keep a path and the tiles it goes through.
+**
+**  @param startPos  Tile where the path starts.
+**  @param path      Directions of the path, first one at the end.
+**  @param length    Length of the path.
+*/
+void PathCacheEntry::SetPath(const Vec2i &startPos, const char *path, int length)
+{
+	Path.assign(path, path + length);
+	Tiles.resize(length + 1);
+	Tiles[0] = startPos;
+	MinPos = startPos;
+	MaxPos = startPos;
+	for (int i = 1; i <= length; ++i) {
+		const int direction = path[length - i];
+
+		Tiles[i].x = Tiles[i - 1].x + Heading2X[direction];
+		Tiles[i].y = Tiles[i - 1].y + Heading2Y[direction];
+		MinPos.x = std::min(MinPos.x, Tiles[i].x);
+		MinPos.y = std::min(MinPos.y, Tiles[i].y);
+		MaxPos.x = std::max(MaxPos.x, Tiles[i].x);
+		MaxPos.y = std::max(MaxPos.y, Tiles[i].y);
+	}
+	MaxPos.x += Query.UnitSize.x - 1;
+	MaxPos.y += Query.UnitSize.y - 1;
+}
+
+/**
+**  Find where a unit can join the path.
+**
+**  @param pos        Tile of the unit.
+**  @param direction  OUT: Direction of the step to the path, -1 if the unit is on it.
+**
+**  @return           Number of steps of the path left behind, -1 if the unit can't join it.
+*/
+int PathCacheEntry::FindTile(const Vec2i &pos, int *direction) const
+{
+	const int length = Path.size();
+
+	// The farthest tile gives the shortest path, the goal itself is of no use.
+	for (int i = length - 1; i >= 0; --i) {
+		const int dx = Tiles[i].x - pos.x;
+		const int dy = Tiles[i].y - pos.y;
+
+		if (dx < -1 || dx > 1 || dy < -1 || dy > 1) {
+			continue;
+		}
+		*direction = (dx == 0 && dy == 0) ? -1 : XY2Heading[dx + 1][dy + 1];
+		return i;
+	}
+	return -1;
+}
+
+/**
+**  Check if the unit following the path covers a tile of an area.
+*/
+bool PathCacheEntry::Crosses(const Vec2i &pos, int w, int h) const
+{
+	if (pos.x > MaxPos.x || pos.y > MaxPos.y || pos.x + w <= MinPos.x || pos.y + h <= MinPos.y) {
+		return false;
+	}
+	for (size_t i = 0; i != Tiles.size(); ++i) {
+		const Vec2i &tile = Tiles[i];
+
+		if (pos.x < tile.x + Query.UnitSize.x && tile.x < pos.x + w
+			&& pos.y < tile.y + Query.UnitSize.y && tile.y < pos.y + h) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+**  Get the explore epoch of the player of a query, 0 when the whole map is known.
+*/
+static unsigned int GetExploreEpoch(const PathCacheQuery &query)
+{
+	return query.Player == -1 ? 0 : PathCacheExploreEpochs[query.Player];
+}
+
+/**
+**  Find a path already found from the same region to the same goal.
+**
+**  The unit must stand on the path or next to it, it gets the rest of
+**  the path.
+**
+**  @return  Distance to the goal, PF_FAILED if no path is known.
+*/
+int PathCacheFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+					  int tilesizex, int tilesizey, int minrange, int maxrange,
+					  char *path, int pathlen, const CUnit &unit)
+{
+	const PathCacheQuery query(startPos, goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit);
+	const unsigned int exploreEpoch = GetExploreEpoch(query);
+
+	for (std::list<PathCacheEntry>::iterator it = PathCache.begin(); it != PathCache.end();) {
+		if (!(it->Query == query)) {
+			++it;
+			continue;
+		}
+		// Unexplored tiles are passable for the search, a newly explored
+		// tile may block the path.
+		if (it->ExploreEpoch != exploreEpoch) {
+			it = PathCache.erase(it);
+			continue;
+		}
+		int direction;
+		const int done = it->FindTile(startPos, &direction);
+		const int length = it->Path.size() - done + (direction != -1);
+
+		if (done == -1 || length > pathlen) {
+			++it;
+			continue;
+		}
+		++Counters.Hits;
+		// Most recently used goes to the front.
+		PathCache.splice(PathCache.begin(), PathCache, it);
+		std::copy(it->Path.begin(), it->Path.end() - done, path);
+		if (direction != -1) {
+			path[length - 1] = direction;
+		}
+		return length;
+	}
+	++Counters.Misses;
+	return PF_FAILED;
+}
+
+/**
+**  Keep a path found by a search.
+**
+**  @param length  Length of the path, only paths to follow are kept.
+*/
+void PathCacheAddPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+					  int tilesizex, int tilesizey, int minrange, int maxrange,
+					  const char *path, int length, const CUnit &unit)
+{
+	if (length <= 0) {
+		return;
+	}
+	const PathCacheQuery query(startPos, goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit);
+	std::list<PathCacheEntry>::iterator it = PathCache.begin();
+
+	while (it != PathCache.end() && !(it->Query == query && it->Tiles[0] == startPos)) {
+		++it;
+	}
+	if (it == PathCache.end()) {
+		if (PathCache.size() >= PathCacheMaxCount) {
+			PathCache.pop_back();
+		}
+		PathCache.push_front(PathCacheEntry(query, GetExploreEpoch(query)));
+		it = PathCache.begin();
+	} else {
+		PathCache.splice(PathCache.begin(), PathCache, it);
+		it->ExploreEpoch = GetExploreEpoch(query);
+	}
+	it->SetPath(startPos, path, length);
+}
+
+/**
+**  Forget the paths kept to a goal.
+**
+**  A unit following one of them has waited too long for units in the
+**  way, the next units going there must search their own path.
+*/
+void PathCacheDropGoal(const Vec2i &goalPos, int gw, int gh,
+					   int tilesizex, int tilesizey, int minrange, int maxrange,
+					   const CUnit &unit)
+{
+	const PathCacheQuery query(goalPos, goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit);
+
+	for (std::list<PathCacheEntry>::iterator it = PathCache.begin(); it != PathCache.end();) {
+		if (it->Query.IsSameGoal(query)) {
+			it = PathCache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+/**
+**  Passability of tiles has changed, forget the paths going through them.
+**
+**  Paths elsewhere stay right, a tile becoming passable (a tree cut)
+**  may only give a shorter one.
+**
+**  @param pos  Top left tile of the changed area.
+**  @param w    Width of the area.
+**  @param h    Height of the area.
+*/
+void PathCacheMapChanged(const Vec2i &pos, int w, int h)
+{
+	for (std::list<PathCacheEntry>::iterator it = PathCache.begin(); it != PathCache.end();) {
+		if (it->Crosses(pos, w, h)) {
+			it = PathCache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+/**
+**  A player has explored a tile, the paths kept for this player may be wrong.
+**
+**  @param player  Index of the player.
+*/
+void PathCacheTerrainExplored(int player)
+{
+	++PathCacheExploreEpochs[player];
+}
+
+/**
+**  Free the kept paths.
+*/
+void FreePathCache()
+{
+	PathCache.clear();
+	Counters.Hits = 0;
+	Counters.Misses = 0;
+}
+
+/**
+**  Get the hits and misses of the path cache.
+*/
+const PathCacheCounters &GetPathCacheCounters()
+{
+	return Counters;
+}
+
+//@}
@@ -39,6 +39,8 @@
 
 #include "pathfinder.h"
 
+#include "SDL.h"
+
 #include "actions.h"
 #include "map.h"
 #include "unittype.h"
@@ -57,10 +59,118 @@ extern int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, in
 						 int tilesizex, int tilesizey, int minrange,
 						 int maxrange, char *path, int pathlen, const CUnit &unit);
 
+//hpa.cpp
+
+/// Init the abstract graphs
+extern void InitHierarchicalPathfinder(const std::vector<int> &masks);
+
+/// Free the abstract graphs
+extern void FreeHierarchicalPathfinder();
+
+/// Static passability of a tile has changed
+extern void HierarchicalTileChanged(const Vec2i &pos);
+
+/// Find a long path for a unit through the abstract graphs
+extern int HierarchicalFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+								int tilesizex, int tilesizey, int minrange,
+								int maxrange, char *path, int pathlen, const CUnit &unit);
+
+//flowfield.cpp
+
+/// Find a path for a unit in a group going to the same goal
+extern int FlowFieldFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+							 int tilesizex, int tilesizey, int minrange,
+							 int maxrange, char *path, int pathlen, const CUnit &unit);
+
+/// Free the flow fields
+extern void FreeFlowFields();
+
+/// Static passability of a tile has changed
+extern void FlowFieldTileChanged(const Vec2i &pos);
+
+//region.cpp
+
+/// Init the regions
+extern void InitMapRegions(const std::vector<int> &masks);
+
+/// Free the regions
+extern void FreeMapRegions();
+
+/// Static passability of a tile has changed
+extern void MapRegionsTileChanged(const Vec2i &pos);
+
+//clearance.cpp
+
+/// Init the clearances
+extern void InitMapClearances(const std::vector<int> &masks);
+
+/// Free the clearances
+extern void FreeMapClearances();
+
+/// Static passability of a tile has changed
+extern void MapClearancesTileChanged(const Vec2i &pos);
+
+//pathcache.cpp
+
+/// Find a path already found for the same query
+extern int PathCacheFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+							 int tilesizex, int tilesizey, int minrange, int maxrange,
+							 char *path, int pathlen, const CUnit &unit);
+
+/// Keep a path found by a search
+extern void PathCacheAddPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+							 int tilesizex, int tilesizey, int minrange, int maxrange,
+							 const char *path, int length, const CUnit &unit);
+
+/// Forget the paths kept to a goal
+extern void PathCacheDropGoal(const Vec2i &goalPos, int gw, int gh,
+							  int tilesizex, int tilesizey, int minrange, int maxrange,
+							  const CUnit &unit);
+
+/// Passability of tiles has changed
+extern void PathCacheMapChanged(const Vec2i &pos, int w, int h);
+
+/// Free the kept paths
+extern void FreePathCache();
+
 /*----------------------------------------------------------------------------
 --  Variables
 ----------------------------------------------------------------------------*/
 
+/// Buffer where the path searches write, as long as the longest path
+static std::vector<char> PathBuffer;
+/// Count of the static changes of the map since InitPathfinder, to check the stored paths
+static unsigned int MapChanges;
+
+/// A* search queued by a unit, solved at the end of UnitActions
+struct PathRequest {
+	CUnit *Unit;             /// unit searching, referenced until the path is given
+	int Result;              /// result of the search
+	std::vector<char> Path;  /// path found, first direction at the end
+};
+
+/// Searches queued in this cycle
+static std::vector<PathRequest> PathRequests;
+
+/// Thread helping the game loop with the queued searches
+struct PathWorker {
+	SDL_Thread *Thread;          /// the thread
+	SDL_sem *Start;              /// posted when the searches are to be solved
+	PathfinderContext *Context;  /// state of the searches of the thread
+	std::vector<char> Buffer;    /// where the searches of the thread write
+	size_t First;                /// first request solved, then one in PathWorkerCount + 1
+};
+
+/// Most threads helping the game loop with the queued searches
+static const int PathWorkerMax = 3;
+/// Fewer queued searches than this are not shared out
+static const size_t PathRequestsParallelMin = 4;
+
+static PathWorker PathWorkers[PathWorkerMax];
+static int PathWorkerCount = -1;  /// threads started, -1 before the first try
+static SDL_sem *PathWorkersDone;  /// posted by a thread when its searches are solved
+static bool PathWorkersQuit;      /// threads must end when started again
+
 void TerrainTraversal::SetSize(unsigned int width, unsigned int height)
 {
 	m_values.resize((width + 2) * (height + 2));
@@ -74,11 +184,12 @@ void TerrainTraversal::Init()
 	const unsigned int width = m_extented_width - 2;
 	const unsigned int width_ext = m_extented_width;
 
+	// Bytes of 0xFF give Blocked.
 	memset(&m_values[0], '\xFF', width_ext * sizeof(dataType));
 	for (unsigned i = 1; i < 1 + height; ++i) {
-		m_values[i * width_ext] = -1;
+		m_values[i * width_ext] = Blocked;
 		memset(&m_values[i * width_ext + 1], '\0', width * sizeof(dataType));
-		m_values[i * width_ext + width + 1] = -1;
+		m_values[i * width_ext + width + 1] = Blocked;
 	}
 	memset(&m_values[(height + 1) * width_ext], '\xFF', width_ext * sizeof(dataType));
 }
@@ -129,12 +240,12 @@ bool TerrainTraversal::IsVisited(const Vec2i &pos) const
 
 bool TerrainTraversal::IsReached(const Vec2i &pos) const
 {
-	return Get(pos) != 0 && Get(pos) != -1;
+	return Get(pos) != 0 && Get(pos) != Blocked;
 }
 
 bool TerrainTraversal::IsInvalid(const Vec2i &pos) const
 {
-	return Get(pos) != -1;
+	return Get(pos) != Blocked;
 }
 
 TerrainTraversal::dataType TerrainTraversal::Get(const Vec2i &pos) const
@@ -151,12 +262,278 @@ void TerrainTraversal::Set(const Vec2i &pos, TerrainTraversal::dataType value)
 --  Functions
 ----------------------------------------------------------------------------*/
 
+/**
+**  Give the result of a search to the unit.
+**
+**  @param output  Path of the unit.
+**  @param path    Path found.
+**  @param pathlen Length of the buffer of the path.
+**  @param result  Result of the search.
+*/
+static void StorePath(PathFinderOutput &output, const char *path, int pathlen, int result)
+{
+	output.Length = std::min<int>(result, pathlen);
+	if (output.Length == 0) {
+		++output.Length;
+	}
+	if (output.Length > 0) {
+		output.Path.assign(path, path + output.Length);
+	}
+	output.MapChanges = MapChanges;
+}
+
+/**
+**  Queue the A* search of a unit, solved by SolvePathRequests.
+**
+**  The unit waits for its path until the next cycle, whatever the
+**  threads, so all the players see the same game.
+*/
+static void QueuePathRequest(CUnit &unit)
+{
+	PathRequests.push_back(PathRequest());
+	PathRequest &request = PathRequests.back();
+
+	request.Unit = &unit;
+	request.Result = PF_FAILED;
+	unit.RefsIncrease();
+	unit.pathFinderData->output.Queued = true;
+	unit.pathFinderData->output.Solved = false;
+}
+
+/**
+**  Solve a queued search.
+**
+**  @param context  Context of the search, NULL for the one of the game loop.
+**  @param buffer   Where the search writes, as long as the longest path.
+**  @param request  Search to solve.
+*/
+static void SolvePathRequest(PathfinderContext *context, std::vector<char> &buffer, PathRequest &request)
+{
+	const PathFinderInput &input = request.Unit->pathFinderData->input;
+	char *path = &buffer[0];
+	const int pathlen = buffer.size();
+	int i;
+
+	if (context) {
+		i = AStarFindPath(*context, input.GetUnitPos(),
+						  input.GetGoalPos(),
+						  input.GetGoalSize().x, input.GetGoalSize().y,
+						  input.GetUnitSize().x, input.GetUnitSize().y,
+						  input.GetMinRange(), input.GetMaxRange(),
+						  path, pathlen,
+						  *request.Unit);
+	} else {
+		i = AStarFindPath(input.GetUnitPos(),
+						  input.GetGoalPos(),
+						  input.GetGoalSize().x, input.GetGoalSize().y,
+						  input.GetUnitSize().x, input.GetUnitSize().y,
+						  input.GetMinRange(), input.GetMaxRange(),
+						  path, pathlen,
+						  *request.Unit);
+	}
+	if (i == PF_FAILED) {
+		i = PF_UNREACHABLE;
+	}
+	request.Result = i;
+	if (i >= 0) {
+		// A wait keeps one direction, as in NewPath.
+		request.Path.assign(path, path + std::max(1, std::min(i, pathlen)));
+	}
+}
+
+/**
+**  Solve the queued searches from the first given, one in slices.
+*/
+static void SolvePathRequests(PathfinderContext *context, std::vector<char> &buffer, size_t first, size_t slices)
+{
+	for (size_t i = first; i < PathRequests.size(); i += slices) {
+		SolvePathRequest(context, buffer, PathRequests[i]);
+	}
+}
+
+static int PathWorkerLoop(void *data)
+{
+	PathWorker &worker = *static_cast<PathWorker *>(data);
+
+	for (;;) {
+		SDL_SemWait(worker.Start);
+		if (PathWorkersQuit) {
+			break;
+		}
+		SolvePathRequests(worker.Context, worker.Buffer, worker.First, PathWorkerCount + 1);
+		SDL_SemPost(PathWorkersDone);
+	}
+	return 0;
+}
+
+/**
+**  Start the threads helping with the queued searches, once.
+**
+**  @return  Number of threads running.
+*/
+static int StartPathWorkers()
+{
+	if (PathWorkerCount != -1) {
+		return PathWorkerCount;
+	}
+	PathWorkerCount = 0;
+	PathWorkersQuit = false;
+	PathWorkersDone = SDL_CreateSemaphore(0);
+	if (PathWorkersDone == NULL) {
+		return 0;
+	}
+	for (int i = 0; i != PathWorkerMax; ++i) {
+		PathWorker &worker = PathWorkers[i];
+
+		worker.Start = SDL_CreateSemaphore(0);
+		if (worker.Start == NULL) {
+			break;
+		}
+		worker.Context = NewPathfinderContext();
+		worker.Buffer.resize(PathBuffer.size());
+		worker.Thread = SDL_CreateThread(PathWorkerLoop, &worker);
+		if (worker.Thread == NULL) {
+			DeletePathfinderContext(worker.Context);
+			std::vector<char>().swap(worker.Buffer);
+			SDL_DestroySemaphore(worker.Start);
+			break;
+		}
+		++PathWorkerCount;
+	}
+	return PathWorkerCount;
+}
+
+/**
+**  Stop the threads helping with the queued searches.
+**
+**  Their contexts have the size of the map, the next game starts them again.
+*/
+static void StopPathWorkers()
+{
+	if (PathWorkerCount == -1) {
+		return;
+	}
+	PathWorkersQuit = true;
+	for (int i = 0; i != PathWorkerCount; ++i) {
+		SDL_SemPost(PathWorkers[i].Start);
+	}
+	for (int i = 0; i != PathWorkerCount; ++i) {
+		PathWorker &worker = PathWorkers[i];
+
+		SDL_WaitThread(worker.Thread, NULL);
+		SDL_DestroySemaphore(worker.Start);
+		DeletePathfinderContext(worker.Context);
+		std::vector<char>().swap(worker.Buffer);
+	}
+	if (PathWorkersDone) {
+		SDL_DestroySemaphore(PathWorkersDone);
+		PathWorkersDone = NULL;
+	}
+	PathWorkerCount = -1;
+}
+
+/// Queued searches are given in the order of the units
+static bool PathRequestLess(const PathRequest &lhs, const PathRequest &rhs)
+{
+	return UnitNumber(*lhs.Unit) < UnitNumber(*rhs.Unit);
+}
+
+/**
+**  Solve the searches queued by the units and give them their paths.
+**
+**  Nothing changes the map while the searches run, so they are shared
+**  out between the game loop and its threads with the same results.
+**  The paths are given in the order of the units.
+*/
+void SolvePathRequests()
+{
+	if (PathRequests.empty()) {
+		return;
+	}
+	std::stable_sort(PathRequests.begin(), PathRequests.end(), PathRequestLess);
+	// Regions are updated when asked, not while the threads read them.
+	for (size_t i = 0; i != PathRequests.size(); ++i) {
+		const CUnit &unit = *PathRequests[i].Unit;
+
+		GetMapRegion(unit.Type->MovementMask, Map.getIndex(unit.tilePos));
+	}
+	if (PathRequests.size() < PathRequestsParallelMin || StartPathWorkers() == 0) {
+		SolvePathRequests(NULL, PathBuffer, 0, 1);
+	} else {
+		for (int i = 0; i != PathWorkerCount; ++i) {
+			PathWorkers[i].First = i + 1;
+			SDL_SemPost(PathWorkers[i].Start);
+		}
+		SolvePathRequests(NULL, PathBuffer, 0, PathWorkerCount + 1);
+		for (int i = 0; i != PathWorkerCount; ++i) {
+			SDL_SemWait(PathWorkersDone);
+		}
+	}
+	for (size_t i = 0; i != PathRequests.size(); ++i) {
+		PathRequest &request = PathRequests[i];
+		CUnit &unit = *request.Unit;
+
+		if (!unit.Destroyed) {
+			PathFinderInput &input = unit.pathFinderData->input;
+			PathFinderOutput &output = unit.pathFinderData->output;
+			const char *path = request.Path.empty() ? NULL : &request.Path[0];
+
+			input.PathRacalculated();
+			PathCacheAddPath(input.GetUnitPos(),
+							 input.GetGoalPos(),
+							 input.GetGoalSize().x, input.GetGoalSize().y,
+							 input.GetUnitSize().x, input.GetUnitSize().y,
+							 input.GetMinRange(), input.GetMaxRange(),
+							 path, request.Result, unit);
+			StorePath(output, path, request.Path.size(), request.Result);
+			output.Queued = false;
+			output.Solved = true;
+		}
+		unit.RefsDecrease();
+	}
+	PathRequests.clear();
+}
+
+/**
+**  Get the static part of the movement masks of the moving unit types.
+**
+**  @param masks  Filled with each different mask once.
+*/
+static void GetStaticMovementMasks(std::vector<int> &masks)
+{
+	const int unitFlags = MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit;
+
+	masks.clear();
+	for (std::vector<CUnitType *>::size_type i = 0; i != UnitTypes.size(); ++i) {
+		const CUnitType &type = *UnitTypes[i];
+		const int mask = type.MovementMask & ~unitFlags;
+
+		// Flying units have nothing static in their way, buildings don't move.
+		if (mask == 0 || type.Building) {
+			continue;
+		}
+		if (std::find(masks.begin(), masks.end(), mask) == masks.end()) {
+			masks.push_back(mask);
+		}
+	}
+}
+
 /**
 **  Init the pathfinder
 */
 void InitPathfinder()
 {
+	std::vector<int> masks;
+
 	InitAStar(Map.Info.MapWidth, Map.Info.MapHeight);
+	PathBuffer.resize(Map.Info.MapWidth * Map.Info.MapHeight);
+	// Units of a saved game are loaded before, their paths are
+	// checked relatively to this count, see PathFinderOutput::Load.
+	MapChanges = 0;
+	GetStaticMovementMasks(masks);
+	InitHierarchicalPathfinder(masks);
+	InitMapRegions(masks);
+	InitMapClearances(masks);
 }
 
 /**
@@ -164,7 +541,47 @@ void InitPathfinder()
 */
 void FreePathfinder()
 {
+	StopPathWorkers();
+	PathRequests.clear();
 	FreeAStar();
+	std::vector<char>().swap(PathBuffer);
+	MapChanges = 0;
+	FreeHierarchicalPathfinder();
+	FreeMapRegions();
+	FreeMapClearances();
+	FreeFlowFields();
+	FreePathCache();
+}
+
+/**
+**  Get the count of the static changes of the map since InitPathfinder.
+*/
+unsigned int GetPathfinderMapChanges()
+{
+	return MapChanges;
+}
+
+/**
+**  Static passability of tiles has changed (terrain, wall, building).
+**
+**  @param pos  Top left tile of the changed area.
+**  @param w    Width of the area.
+**  @param h    Height of the area.
+*/
+void PathfinderTilesChanged(const Vec2i &pos, int w, int h)
+{
+	++MapChanges;
+	PathCacheMapChanged(pos, w, h);
+	for (Vec2i it = pos; it.y != pos.y + h; ++it.y) {
+		for (it.x = pos.x; it.x != pos.x + w; ++it.x) {
+			if (Map.Info.IsPointOnMap(it)) {
+				HierarchicalTileChanged(it);
+				MapRegionsTileChanged(it);
+				MapClearancesTileChanged(it);
+				FlowFieldTileChanged(it);
+			}
+		}
+	}
 }
 
 /*----------------------------------------------------------------------------
@@ -306,9 +723,32 @@ void PathFinderInput::PathRacalculated()
 }
 
 
-PathFinderOutput::PathFinderOutput()
+PathFinderOutput::PathFinderOutput() : Cycles(0), Fast(0), Length(0), MapChanges(0),
+	Queued(false), Solved(false)
+{
+}
+
+/**
+**  Check if the remaining path crosses a tile which can't be entered
+**  anymore, whatever the units do.
+*/
+static bool IsPathBlocked(const CUnit &unit, const PathFinderOutput &output)
 {
-	memset(this, 0, sizeof(*this));
+	const int mask = unit.Type->MovementMask & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit);
+	Vec2i pos = unit.tilePos;
+
+	for (int i = output.Length - 1; i >= 0; --i) {
+		pos.x += Heading2X[(int)output.Path[i]];
+		pos.y += Heading2Y[(int)output.Path[i]];
+		for (int y = 0; y != unit.Type->TileHeight; ++y) {
+			for (int x = 0; x != unit.Type->TileWidth; ++x) {
+				if (Map.CheckMask(pos + Vec2i(x, y), mask)) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
 }
 
 /**
@@ -319,33 +759,83 @@ PathFinderOutput::PathFinderOutput()
 **
 **  @note  The destination could become negative coordinates!
 **
-**  @param unit  Path for this unit.
+**  @param input   Path for this unit.
+**  @param output  Computed path.
+**  @param shared  Allow to follow the flow field of a group, and queue
+**                 the A* search to be solved with the others.
 **
-**  @return      >0 remaining path length, 0 wait for path, -1
-**               reached goal, -2 can't reach the goal.
+**  @return        >0 remaining path length, 0 wait for path, -1
+**                 reached goal, -2 can't reach the goal.
 */
-static int NewPath(PathFinderInput &input, PathFinderOutput &output)
+static int NewPath(PathFinderInput &input, PathFinderOutput &output, bool shared)
 {
-	char *path = output.Path;
-	int i = AStarFindPath(input.GetUnitPos(),
+	// Paths are long as needed, the searches write in a buffer as
+	// long as the longest path, and the path is copied to the unit.
+	char *path = &PathBuffer[0];
+	const int pathlen = PathBuffer.size();
+	int i = PF_FAILED;
+	// Units going back and forth ask again for the same paths.
+	if (shared) {
+		i = PathCacheFindPath(input.GetUnitPos(),
+							  input.GetGoalPos(),
+							  input.GetGoalSize().x, input.GetGoalSize().y,
+							  input.GetUnitSize().x, input.GetUnitSize().y,
+							  input.GetMinRange(), input.GetMaxRange(),
+							  path, pathlen,
+							  *input.GetUnit());
+	}
+	const bool cached = i != PF_FAILED;
+	// Units of a group going to the same place share the same field.
+	if (shared && i == PF_FAILED) {
+		i = FlowFieldFindPath(input.GetUnitPos(),
+							  input.GetGoalPos(),
+							  input.GetGoalSize().x, input.GetGoalSize().y,
+							  input.GetUnitSize().x, input.GetUnitSize().y,
+							  input.GetMinRange(), input.GetMaxRange(),
+							  path, pathlen,
+							  *input.GetUnit());
+	}
+	// Long paths are first solved on the abstract graph.
+	if (i == PF_FAILED) {
+		i = HierarchicalFindPath(input.GetUnitPos(),
+								 input.GetGoalPos(),
+								 input.GetGoalSize().x, input.GetGoalSize().y,
+								 input.GetUnitSize().x, input.GetUnitSize().y,
+								 input.GetMinRange(), input.GetMaxRange(),
+								 path, pathlen,
+								 *input.GetUnit());
+	}
+	// The paths given to the units don't depend on the threads.
+	if (i == PF_FAILED && shared) {
+		QueuePathRequest(*input.GetUnit());
+		return PF_WAIT;
+	}
+	if (i == PF_FAILED) {
+		i = AStarFindPath(input.GetUnitPos(),
 						  input.GetGoalPos(),
 						  input.GetGoalSize().x, input.GetGoalSize().y,
 						  input.GetUnitSize().x, input.GetUnitSize().y,
 						  input.GetMinRange(), input.GetMaxRange(),
-						  path, PathFinderOutput::MAX_PATH_LENGTH,
+						  path, pathlen,
 						  *input.GetUnit());
+	}
 	input.PathRacalculated();
 	if (i == PF_FAILED) {
 		i = PF_UNREACHABLE;
 	}
+	if (shared && !cached) {
+		PathCacheAddPath(input.GetUnitPos(),
+						 input.GetGoalPos(),
+						 input.GetGoalSize().x, input.GetGoalSize().y,
+						 input.GetUnitSize().x, input.GetUnitSize().y,
+						 input.GetMinRange(), input.GetMaxRange(),
+						 path, i, *input.GetUnit());
+	}
 
 	// Update path if it was requested. Otherwise we may only want
 	// to know if there exists a path.
 	if (path != NULL) {
-		output.Length = std::min<int>(i, PathFinderOutput::MAX_PATH_LENGTH);
-		if (output.Length == 0) {
-			++output.Length;
-		}
+		StorePath(output, path, pathlen, i);
 	}
 	return i;
 }
@@ -371,9 +861,29 @@ int NextPathElement(CUnit &unit, short int *pxd, short int *pyd)
 	*pxd = 0;
 	*pyd = 0;
 
+	// The search queued by the unit is solved at the end of the cycle.
+	if (output.Queued) {
+		return PF_WAIT;
+	}
+	if (output.Solved) {
+		output.Solved = false;
+		if (output.Length < 0 && !input.IsRecalculateNeeded()) {
+			const int result = output.Length;
+
+			output.Length = 0;
+			return result;
+		}
+	}
+	// A building or a wall may have been put on the way.
+	if (output.Length > 0 && output.MapChanges != MapChanges) {
+		output.MapChanges = MapChanges;
+		if (IsPathBlocked(unit, output)) {
+			output.Length = 0;
+		}
+	}
 	// Goal has moved, need to recalculate path or no cached path
 	if (output.Length <= 0 || input.IsRecalculateNeeded()) {
-		const int result = NewPath(input, output);
+		const int result = NewPath(input, output, true);
 
 		if (result == PF_UNREACHABLE) {
 			output.Length = 0;
@@ -390,28 +900,37 @@ int NextPathElement(CUnit &unit, short int *pxd, short int *pyd)
 	int result = output.Length;
 	output.Length--;
 	if (!UnitCanBeAt(unit, unit.tilePos + dir)) {
+		// Keep the step for when the way is free.
+		output.Length++;
+		result = PF_WAIT;
 		// If obstructing unit is moving, wait for a bit.
-		if (output.Fast) {
-			output.Fast--;
-			AstarDebugPrint("WAIT at %d\n" _C_ output.Fast);
-			result = PF_WAIT;
-		} else {
+		if (output.Fast == 0) {
 			output.Fast = 10;
 			AstarDebugPrint("SET WAIT to 10\n");
-			result = PF_WAIT;
-		}
-		if (output.Fast == 0 && result != 0) {
+		} else if (--output.Fast != 0) {
+			AstarDebugPrint("WAIT at %d\n" _C_ output.Fast);
+		} else {
 			AstarDebugPrint("WAIT expired\n");
-			result = NewPath(input, output);
+			// Other units would get the same kept path and wait there too.
+			PathCacheDropGoal(input.GetGoalPos(),
+							  input.GetGoalSize().x, input.GetGoalSize().y,
+							  input.GetUnitSize().x, input.GetUnitSize().y,
+							  input.GetMinRange(), input.GetMaxRange(), unit);
+			// The field doesn't know about the units in the way.
+			result = NewPath(input, output, false);
+			*pxd = 0;
+			*pyd = 0;
 			if (result > 0) {
-				*pxd = Heading2X[(int)output.Path[(int)output.Length - 1]];
-				*pyd = Heading2Y[(int)output.Path[(int)output.Length - 1]];
-				if (!UnitCanBeAt(unit, unit.tilePos + dir)) {
+				const Vec2i newDir(Heading2X[(int)output.Path[(int)output.Length - 1]],
+								   Heading2Y[(int)output.Path[(int)output.Length - 1]]);
+
+				if (!UnitCanBeAt(unit, unit.tilePos + newDir)) {
 					// There may be unit in the way, Astar may allow you to walk onto it.
 					result = PF_UNREACHABLE;
-					*pxd = 0;
-					*pyd = 0;
+					output.Length = 0;
 				} else {
+					*pxd = newDir.x;
+					*pyd = newDir.y;
 					result = output.Length;
 					output.Length--;
 				}
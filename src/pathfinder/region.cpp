@@ -0,0 +1,493 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name region.cpp - Connected regions of the map. */
+//
+//      For each movement mask, tiles which can be reached from each other
+//      by terrain only share the same region. Regions are labelled inside
+//      each cluster of the map, and the labels of neighbour clusters are
+//      joined along their borders. A change of passability only relabels
+//      its cluster and then joins the borders again.
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "pathfinder.h"
+
+#include "map.h"
+
+#include <algorithm>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/// Size in tiles of a cluster side
+static const int RegionClusterSize = 16;
+/// Max number of local regions in a cluster (8-connexity)
+static const int MaxLocalRegions = (RegionClusterSize / 2) * (RegionClusterSize / 2);
+/// Unit flags, they are not static obstacles
+static const int UnitFieldFlags = MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit;
+
+/**
+**  Link between two local regions of neighbour clusters.
+**
+**  Links of a cluster are kept sorted, so those of one local region
+**  follow each other.
+*/
+struct RegionLink {
+	int From;                              /// Local region of the cluster
+	int To;                                /// Local region of the neighbour cluster
+
+	bool operator <(const RegionLink &rhs) const {
+		return From < rhs.From || (From == rhs.From && To < rhs.To);
+	}
+	bool operator ==(const RegionLink &rhs) const {
+		return From == rhs.From && To == rhs.To;
+	}
+};
+
+/**
+**  Connected regions of the map for one movement mask.
+**
+**  LocalLabels gives for each tile its region inside its cluster
+**  (0 when the tile is blocked), Regions gives for each local region
+**  (cluster * MaxLocalRegions + label - 1) its region on the whole map.
+**
+**  The local regions and the links between them form a graph, so a
+**  change only labels again its cluster, links it again with its
+**  neighbours, and floods the regions of the graph which touch it.
+*/
+class CRegionLayer
+{
+public:
+	explicit CRegionLayer(int mask) : Mask(mask & ~UnitFieldFlags), Width(0), Height(0),
+		VisitCount(0), RegionCount(0) {}
+
+	void Init();
+	void MarkChanged(const Vec2i &pos);
+	int GetRegion(unsigned int index);
+
+	int GetMask() const { return Mask; }
+
+private:
+	int GetClusterIndex(const Vec2i &pos) const {
+		return pos.y / RegionClusterSize * Width + pos.x / RegionClusterSize;
+	}
+	void GetClusterArea(int cluster, Vec2i &topLeft, Vec2i &bottomRight) const;
+	int GetNeighbourClusters(int cluster, int *neighbours) const;
+	int GetLocalRegion(const Vec2i &pos) const;
+	void Update();
+	void LabelCluster(int cluster);
+	void UnlinkCluster(int cluster);
+	void LinkClusters(int cluster1, int cluster2);
+	void FloodRegion(int localRegion, std::vector<int> &stack);
+
+private:
+	int Mask;                              /// Static part of the movement mask
+	int Width;                             /// Number of clusters in a row
+	int Height;                            /// Number of clusters in a column
+	std::vector<unsigned char> LocalLabels; /// Region of each tile inside its cluster
+	std::vector<unsigned char> LabelCounts; /// Number of local regions of each cluster
+	std::vector<std::vector<RegionLink> > Links; /// Links of each cluster with its neighbours
+	std::vector<int> Regions;              /// Region of each local region
+	std::vector<unsigned int> Visits;      /// Last flood which reached each local region
+	unsigned int VisitCount;               /// Number of the current flood
+	int RegionCount;                       /// Last region number given
+	std::vector<char> ClusterDirty;        /// Cluster must be labelled again
+	std::vector<int> DirtyClusters;        /// Clusters to label again
+};
+
+/**
+**  Tell if a link goes to the given cluster.
+*/
+class LinkToCluster
+{
+public:
+	explicit LinkToCluster(int cluster) : Cluster(cluster) {}
+
+	bool operator()(const RegionLink &link) const { return link.To / MaxLocalRegions == Cluster; }
+
+private:
+	int Cluster;
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+/// Regions for each movement mask in use
+static std::vector<CRegionLayer> RegionLayers;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Label the whole map.
+*/
+void CRegionLayer::Init()
+{
+	Width = (Map.Info.MapWidth + RegionClusterSize - 1) / RegionClusterSize;
+	Height = (Map.Info.MapHeight + RegionClusterSize - 1) / RegionClusterSize;
+
+	LocalLabels.assign(Map.Info.MapWidth * Map.Info.MapHeight, 0);
+	LabelCounts.assign(Width * Height, 0);
+	Links.assign(Width * Height, std::vector<RegionLink>());
+	Regions.assign(Width * Height * MaxLocalRegions, 0);
+	Visits.assign(Width * Height * MaxLocalRegions, 0);
+	VisitCount = 0;
+	RegionCount = 0;
+	ClusterDirty.assign(Width * Height, 0);
+	DirtyClusters.clear();
+
+	for (int i = 0; i != Width * Height; ++i) {
+		ClusterDirty[i] = 1;
+		DirtyClusters.push_back(i);
+	}
+	Update();
+}
+
+/**
+**  Passability of a tile has changed, relabel its cluster at next query.
+*/
+void CRegionLayer::MarkChanged(const Vec2i &pos)
+{
+	const int cluster = GetClusterIndex(pos);
+
+	if (!ClusterDirty[cluster]) {
+		ClusterDirty[cluster] = 1;
+		DirtyClusters.push_back(cluster);
+	}
+}
+
+/**
+**  Get the tiles covered by a cluster.
+*/
+void CRegionLayer::GetClusterArea(int cluster, Vec2i &topLeft, Vec2i &bottomRight) const
+{
+	topLeft.x = (cluster % Width) * RegionClusterSize;
+	topLeft.y = (cluster / Width) * RegionClusterSize;
+	bottomRight.x = std::min(topLeft.x + RegionClusterSize, (int)Map.Info.MapWidth) - 1;
+	bottomRight.y = std::min(topLeft.y + RegionClusterSize, (int)Map.Info.MapHeight) - 1;
+}
+
+/**
+**  Get the (up to 8) clusters around a cluster.
+**
+**  @return  Number of neighbours written in neighbours.
+*/
+int CRegionLayer::GetNeighbourClusters(int cluster, int *neighbours) const
+{
+	const int cx = cluster % Width;
+	const int cy = cluster / Width;
+	int count = 0;
+
+	for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, Height - 1); ++y) {
+		for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, Width - 1); ++x) {
+			if (x != cx || y != cy) {
+				neighbours[count++] = y * Width + x;
+			}
+		}
+	}
+	return count;
+}
+
+/**
+**  Get the local region index of a tile, -1 if blocked.
+*/
+int CRegionLayer::GetLocalRegion(const Vec2i &pos) const
+{
+	const int label = LocalLabels[Map.getIndex(pos)];
+
+	return label ? GetClusterIndex(pos) * MaxLocalRegions + label - 1 : -1;
+}
+
+/**
+**  Flood fill each part of a cluster with its own label.
+*/
+void CRegionLayer::LabelCluster(int cluster)
+{
+	Vec2i topLeft;
+	Vec2i bottomRight;
+	GetClusterArea(cluster, topLeft, bottomRight);
+	// 0 : blocked, 0xFF : not labelled yet.
+	for (Vec2i pos = topLeft; pos.y <= bottomRight.y; ++pos.y) {
+		for (pos.x = topLeft.x; pos.x <= bottomRight.x; ++pos.x) {
+			const unsigned int index = Map.getIndex(pos);
+			LocalLabels[index] = Map.CheckMask(index, Mask) ? 0 : 0xFF;
+		}
+	}
+
+	unsigned char label = 0;
+	std::vector<Vec2i> stack;
+	for (Vec2i pos = topLeft; pos.y <= bottomRight.y; ++pos.y) {
+		for (pos.x = topLeft.x; pos.x <= bottomRight.x; ++pos.x) {
+			if (LocalLabels[Map.getIndex(pos)] != 0xFF) {
+				continue;
+			}
+			++label;
+			Assert(label <= MaxLocalRegions);
+			LocalLabels[Map.getIndex(pos)] = label;
+			stack.push_back(pos);
+			while (!stack.empty()) {
+				const Vec2i current = stack.back();
+				stack.pop_back();
+				for (int i = 0; i < 8; ++i) {
+					const Vec2i newPos(current.x + Heading2X[i], current.y + Heading2Y[i]);
+
+					if (newPos.x < topLeft.x || newPos.x > bottomRight.x
+						|| newPos.y < topLeft.y || newPos.y > bottomRight.y) {
+						continue;
+					}
+					unsigned char &newLabel = LocalLabels[Map.getIndex(newPos)];
+					if (newLabel == 0xFF) {
+						newLabel = label;
+						stack.push_back(newPos);
+					}
+				}
+			}
+		}
+	}
+	LabelCounts[cluster] = label;
+}
+
+/**
+**  Remove the links of a cluster, on its side and on its neighbours side.
+*/
+void CRegionLayer::UnlinkCluster(int cluster)
+{
+	int neighbours[8];
+	const int count = GetNeighbourClusters(cluster, neighbours);
+
+	Links[cluster].clear();
+	for (int i = 0; i != count; ++i) {
+		std::vector<RegionLink> &links = Links[neighbours[i]];
+
+		links.erase(std::remove_if(links.begin(), links.end(), LinkToCluster(cluster)), links.end());
+	}
+}
+
+/**
+**  Link the local regions of two neighbour clusters along their border.
+*/
+void CRegionLayer::LinkClusters(int cluster1, int cluster2)
+{
+	Vec2i topLeft1, bottomRight1;
+	Vec2i topLeft2, bottomRight2;
+	GetClusterArea(cluster1, topLeft1, bottomRight1);
+	GetClusterArea(cluster2, topLeft2, bottomRight2);
+	std::vector<RegionLink> &links1 = Links[cluster1];
+	std::vector<RegionLink> &links2 = Links[cluster2];
+
+	// Only the tiles of cluster1 next to cluster2.
+	const Vec2i first(std::max<int>(topLeft1.x, topLeft2.x - 1), std::max<int>(topLeft1.y, topLeft2.y - 1));
+	const Vec2i last(std::min<int>(bottomRight1.x, bottomRight2.x + 1), std::min<int>(bottomRight1.y, bottomRight2.y + 1));
+	for (Vec2i pos = first; pos.y <= last.y; ++pos.y) {
+		for (pos.x = first.x; pos.x <= last.x; ++pos.x) {
+			const int region1 = GetLocalRegion(pos);
+
+			if (region1 == -1) {
+				continue;
+			}
+			for (int i = 0; i < 8; ++i) {
+				const Vec2i newPos(pos.x + Heading2X[i], pos.y + Heading2Y[i]);
+
+				if (newPos.x < topLeft2.x || newPos.x > bottomRight2.x
+					|| newPos.y < topLeft2.y || newPos.y > bottomRight2.y) {
+					continue;
+				}
+				const int region2 = GetLocalRegion(newPos);
+				if (region2 == -1) {
+					continue;
+				}
+				const RegionLink link1 = {region1, region2};
+				const RegionLink link2 = {region2, region1};
+				links1.push_back(link1);
+				links2.push_back(link2);
+			}
+		}
+	}
+	std::sort(links1.begin(), links1.end());
+	links1.erase(std::unique(links1.begin(), links1.end()), links1.end());
+	std::sort(links2.begin(), links2.end());
+	links2.erase(std::unique(links2.begin(), links2.end()), links2.end());
+}
+
+/**
+**  Give a new region to all the local regions linked to localRegion,
+**  unless the current flood has already reached it.
+*/
+void CRegionLayer::FloodRegion(int localRegion, std::vector<int> &stack)
+{
+	if (Visits[localRegion] == VisitCount) {
+		return;
+	}
+	++RegionCount;
+	Visits[localRegion] = VisitCount;
+	Regions[localRegion] = RegionCount;
+	stack.push_back(localRegion);
+	while (!stack.empty()) {
+		const int current = stack.back();
+		stack.pop_back();
+
+		const std::vector<RegionLink> &links = Links[current / MaxLocalRegions];
+		const RegionLink key = {current, -1};
+		for (std::vector<RegionLink>::const_iterator it = std::lower_bound(links.begin(), links.end(), key);
+			 it != links.end() && it->From == current; ++it) {
+			if (Visits[it->To] != VisitCount) {
+				Visits[it->To] = VisitCount;
+				Regions[it->To] = RegionCount;
+				stack.push_back(it->To);
+			}
+		}
+	}
+}
+
+/**
+**  Label again the clusters which have changed, link them again with
+**  their neighbours and flood the regions which touch them.
+**
+**  Regions which don't touch a changed cluster keep their number.
+*/
+void CRegionLayer::Update()
+{
+	if (DirtyClusters.empty()) {
+		return;
+	}
+	int neighbours[9]; // Room for the cluster itself.
+
+	for (size_t i = 0; i != DirtyClusters.size(); ++i) {
+		LabelCluster(DirtyClusters[i]);
+	}
+	// Remove all old links before adding any new one.
+	for (size_t i = 0; i != DirtyClusters.size(); ++i) {
+		UnlinkCluster(DirtyClusters[i]);
+	}
+	for (size_t i = 0; i != DirtyClusters.size(); ++i) {
+		const int cluster = DirtyClusters[i];
+		const int count = GetNeighbourClusters(cluster, neighbours);
+
+		for (int j = 0; j != count; ++j) {
+			// Two changed neighbours are linked once.
+			if (!ClusterDirty[neighbours[j]] || neighbours[j] > cluster) {
+				LinkClusters(cluster, neighbours[j]);
+			}
+		}
+	}
+	// A region split or merged by the change has a local region
+	// in a changed cluster or in one of its neighbours.
+	std::vector<int> stack;
+	++VisitCount;
+	for (size_t i = 0; i != DirtyClusters.size(); ++i) {
+		const int cluster = DirtyClusters[i];
+		const int count = GetNeighbourClusters(cluster, neighbours);
+
+		neighbours[count] = cluster;
+		for (int j = 0; j <= count; ++j) {
+			for (int label = 0; label != LabelCounts[neighbours[j]]; ++label) {
+				FloodRegion(neighbours[j] * MaxLocalRegions + label, stack);
+			}
+		}
+	}
+	for (size_t i = 0; i != DirtyClusters.size(); ++i) {
+		ClusterDirty[DirtyClusters[i]] = 0;
+	}
+	DirtyClusters.clear();
+}
+
+/**
+**  Get the region of a tile, 0 if the tile is blocked.
+*/
+int CRegionLayer::GetRegion(unsigned int index)
+{
+	Update();
+	const int label = LocalLabels[index];
+	if (label == 0) {
+		return 0;
+	}
+	const Vec2i pos(index % Map.Info.MapWidth, index / Map.Info.MapWidth);
+	return Regions[GetClusterIndex(pos) * MaxLocalRegions + label - 1];
+}
+
+/**
+**  Init the regions for the given movement masks.
+*/
+void InitMapRegions(const std::vector<int> &masks)
+{
+	RegionLayers.clear();
+	for (size_t i = 0; i != masks.size(); ++i) {
+		RegionLayers.push_back(CRegionLayer(masks[i]));
+		RegionLayers.back().Init();
+	}
+}
+
+/**
+**  Free the regions.
+*/
+void FreeMapRegions()
+{
+	RegionLayers.clear();
+}
+
+/**
+**  Static passability of a tile has changed.
+*/
+void MapRegionsTileChanged(const Vec2i &pos)
+{
+	for (size_t i = 0; i != RegionLayers.size(); ++i) {
+		RegionLayers[i].MarkChanged(pos);
+	}
+}
+
+/**
+**  Get the region of a tile for a movement mask.
+**
+**  Tiles of a same region can be reached from each other by a unit
+**  using this mask, when no unit is in the way.
+**
+**  @param movemask  Movement mask of the unit type.
+**  @param index     Flat index of the tile.
+**
+**  @return          0 if the tile is blocked or the mask unknown, else the region.
+*/
+int GetMapRegion(int movemask, unsigned int index)
+{
+	const int mask = movemask & ~UnitFieldFlags;
+
+	for (size_t i = 0; i != RegionLayers.size(); ++i) {
+		if (RegionLayers[i].GetMask() == mask) {
+			return RegionLayers[i].GetRegion(index);
+		}
+	}
+	return 0;
+}
+
+//@}
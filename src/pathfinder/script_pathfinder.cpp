@@ -101,12 +101,49 @@ static int CclAStar(lua_State *l)
 	return 0;
 }
 
+/**
+**  Get the counters of the a* searches.
+**
+**  @param l  Lua state.
+**
+**  @return   Number of searches, of matrix clears avoided and of matrix clears.
+*/
+static int CclGetAStarCounters(lua_State *l)
+{
+	LuaCheckArgs(l, 0);
+	const AStarCounters &counters = GetAStarCounters();
+
+	lua_pushnumber(l, counters.Searches);
+	lua_pushnumber(l, counters.FullClearsAvoided);
+	lua_pushnumber(l, counters.FullClears);
+	return 3;
+}
+
+/**
+**  Get the counters of the path cache.
+**
+**  @param l  Lua state.
+**
+**  @return   Number of paths found in the cache and of paths not found.
+*/
+static int CclGetPathCacheCounters(lua_State *l)
+{
+	LuaCheckArgs(l, 0);
+	const PathCacheCounters &counters = GetPathCacheCounters();
+
+	lua_pushnumber(l, counters.Hits);
+	lua_pushnumber(l, counters.Misses);
+	return 2;
+}
+
 /**
 **  Register CCL features for pathfinder.
 */
 void PathfinderCclRegister()
 {
 	lua_register(Lua, "AStar", CclAStar);
+	lua_register(Lua, "GetAStarCounters", CclGetAStarCounters);
+	lua_register(Lua, "GetPathCacheCounters", CclGetPathCacheCounters);
 }
 
 //@}
@@ -222,12 +222,27 @@ void PathFinderOutput::Load(lua_State *l)
 		} else if (!strcmp(tag, "fast")) {
 			this->Fast = 1;
 			--i;
+		} else if (!strcmp(tag, "map-changes")) {
+			// Relative to the count of InitPathfinder, which is 0 and
+			// is called after the units are loaded.
+			lua_rawgeti(l, -1, i);
+			this->MapChanges = 0u - static_cast<unsigned int>(LuaToNumber(l, -1));
+			lua_pop(l, 1);
+		} else if (!strcmp(tag, "solved")) {
+			lua_rawgeti(l, -1, i);
+			const int result = LuaToNumber(l, -1);
+			lua_pop(l, 1);
+			this->Solved = true;
+			if (result < 0) {
+				this->Length = result;
+			}
 		} else if (!strcmp(tag, "path")) {
 			lua_rawgeti(l, -1, i);
 			if (!lua_istable(l, -1)) {
 				LuaError(l, "incorrect argument _");
 			}
 			const int subargs = lua_rawlen(l, -1);
+			this->Path.resize(subargs);
 			for (int k = 0; k < subargs; ++k) {
 				lua_rawgeti(l, -1, k + 1);
 				this->Path[k] = LuaToNumber(l, -1);
@@ -450,6 +450,7 @@ void CUnit::Init()
 	LastGroup = 0;
 	ResourcesHeld = 0;
 	Wait = 0;
+	ParkedAction = UnitActionNone;
 	Blink = 0;
 	Moving = 0;
 	ReCast = 0;
@@ -525,6 +526,7 @@ void CUnit::Release(bool final)
 		delete *order;
 	}
 	Orders.clear();
+	WakeUpUnit(*this);
 
 	// Remove the unit from the global units table.
 	UnitManager.ReleaseUnit(this);
@@ -537,6 +539,7 @@ unsigned int CUnit::CurrentAction() const
 
 void CUnit::ClearAction()
 {
+	WakeUpUnit(*this);
 	Orders[0]->Finished = true;
 
 	if (Selected) {
@@ -647,6 +650,7 @@ bool CUnit::RestoreOrder()
 
 	// Cannot delete this->Orders[0] since it is generally that order
 	// which call this method.
+	WakeUpUnit(*this);
 	this->Orders[0]->Finished = true;
 
 	//copy
@@ -856,6 +860,91 @@ void MapUnmarkUnitSight(CUnit &unit)
 	}
 }
 
+/**
+**  (Un)Mark on vision table the Sight of the unit at a place, which it
+**  doesn't have at another place.
+**  (and units inside for transporter (recursively))
+**
+**  @param unit    Unit to (un)mark.
+**  @param from    coord of the unit where the sight is not (un)marked.
+**  @param to      coord of the unit where the sight is (un)marked.
+**  @param width   Width of the unit.
+**  @param height  Height of the unit.
+**  @param f       Function to (un)mark for normal vision.
+**  @param f2      Function to (un)mark for cloaking vision.
+*/
+static void MapMarkUnitSightDeltaRec(const CUnit &unit, const Vec2i &from, const Vec2i &to,
+									 int width, int height, MapMarkerFunc *f, MapMarkerFunc *f2)
+{
+	Assert(f);
+	const int range = unit.Container ? unit.Container->CurrentSightRange : unit.CurrentSightRange;
+
+	MapSightDelta(*unit.Player, from, to, width, height, range, f);
+
+	if (unit.Type && unit.Type->DetectCloak && f2) {
+		MapSightDelta(*unit.Player, from, to, width, height, range, f2);
+	}
+
+	CUnit *unit_inside = unit.UnitInside;
+	for (int i = unit.InsideCount; i--; unit_inside = unit_inside->NextContained) {
+		MapMarkUnitSightDeltaRec(*unit_inside, from, to, width, height, f, f2);
+	}
+}
+
+/**
+**  Unmark on vision table the Sight of the unit before it moves,
+**  except for the tiles it will still see after.
+**
+**  @param unit    unit on the map to unmark its vision.
+**  @param newPos  where the unit will be.
+**  @see MapMarkUnitSightMoved.
+*/
+static void MapUnmarkUnitSightMoving(CUnit &unit, const Vec2i &newPos)
+{
+	const CUnitType &type = *unit.Type;
+
+	MapMarkUnitSightDeltaRec(unit, newPos, unit.tilePos, type.TileWidth, type.TileHeight,
+							 MapUnmarkTileSight, MapUnmarkTileDetectCloak);
+
+	if (!unit.IsUnusable()) {
+		if (unit.Stats->Variables[RADAR_INDEX].Value) {
+			MapSightDelta(*unit.Player, newPos, unit.tilePos, type.TileWidth, type.TileHeight,
+						  unit.Stats->Variables[RADAR_INDEX].Value, MapUnmarkRadarSpan);
+		}
+		if (unit.Stats->Variables[RADARJAMMER_INDEX].Value) {
+			MapSightDelta(*unit.Player, newPos, unit.tilePos, type.TileWidth, type.TileHeight,
+						  unit.Stats->Variables[RADARJAMMER_INDEX].Value, MapUnmarkRadarJammerSpan);
+		}
+	}
+}
+
+/**
+**  Mark on vision table the Sight of the unit after it has moved,
+**  except for the tiles it already saw before.
+**
+**  @param unit    unit on the map to mark its vision.
+**  @param oldPos  where the unit was.
+**  @see MapUnmarkUnitSightMoving.
+*/
+static void MapMarkUnitSightMoved(CUnit &unit, const Vec2i &oldPos)
+{
+	const CUnitType &type = *unit.Type;
+
+	MapMarkUnitSightDeltaRec(unit, oldPos, unit.tilePos, type.TileWidth, type.TileHeight,
+							 MapMarkTileSight, MapMarkTileDetectCloak);
+
+	if (!unit.IsUnusable()) {
+		if (unit.Stats->Variables[RADAR_INDEX].Value) {
+			MapSightDelta(*unit.Player, oldPos, unit.tilePos, type.TileWidth, type.TileHeight,
+						  unit.Stats->Variables[RADAR_INDEX].Value, MapMarkRadarSpan);
+		}
+		if (unit.Stats->Variables[RADARJAMMER_INDEX].Value) {
+			MapSightDelta(*unit.Player, oldPos, unit.tilePos, type.TileWidth, type.TileHeight,
+						  unit.Stats->Variables[RADARJAMMER_INDEX].Value, MapMarkRadarJammerSpan);
+		}
+	}
+}
+
 /**
 **  Update the Unit Current sight range to good value and transported units inside.
 **
@@ -916,6 +1005,9 @@ void MarkUnitFieldFlags(const CUnit &unit)
 		} while (--w);
 		index += Map.Info.MapWidth;
 	} while (--h);
+	if (flags & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)) {
+		PathfinderTilesChanged(unit.tilePos, width, unit.Type->TileHeight);
+	}
 }
 
 class _UnmarkUnitFieldFlags
@@ -963,6 +1055,9 @@ void UnmarkUnitFieldFlags(const CUnit &unit)
 		} while (--w);
 		index += Map.Info.MapWidth;
 	} while (--h);
+	if (unit.Type->FieldFlags & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)) {
+		PathfinderTilesChanged(unit.tilePos, width, unit.Type->TileHeight);
+	}
 }
 
 /**
@@ -1042,7 +1137,11 @@ static void UnitInXY(CUnit &unit, const Vec2i &pos)
 */
 void CUnit::MoveToXY(const Vec2i &pos)
 {
-	MapUnmarkUnitSight(*this);
+	const Vec2i oldPos = tilePos;
+
+	Assert(!Container);
+	// Only the tiles seen from one place and not the other change.
+	MapUnmarkUnitSightMoving(*this, pos);
 	Map.Remove(*this);
 	UnmarkUnitFieldFlags(*this);
 
@@ -1052,9 +1151,9 @@ void CUnit::MoveToXY(const Vec2i &pos)
 
 	Map.Insert(*this);
 	MarkUnitFieldFlags(*this);
-	//  Recalculate the seen count.
-	UnitCountSeen(*this);
-	MapMarkUnitSight(*this);
+	//  Update the seen count with the tiles left and entered.
+	UnitCountSeenMoved(*this, oldPos);
+	MapMarkUnitSightMoved(*this, oldPos);
 }
 
 /**
@@ -1266,6 +1365,7 @@ void UnitClearOrders(CUnit &unit)
 	}
 	unit.Orders.clear();
 	unit.Orders.push_back(COrder::NewActionStill());
+	WakeUpUnit(unit);
 }
 
 /**
@@ -1581,18 +1681,76 @@ void UnitsOnTileUnmarkSeen(const CPlayer &player, int x, int y, int cloak)
 
 
 /**
-**  Recalculates a units visiblity count. This happens really often,
-**  Like every time a unit moves. It's really fast though, since we
-**  have per-tile counts.
+**  Check if a player sees a unit on one of its tiles.
 **
-**  @param unit  pointer to the unit to check if seen
+**  @param unit   Unit to check.
+**  @param p      Index of the player.
+**  @param index  Flat index of a tile of the unit.
 */
-void UnitCountSeen(CUnit &unit)
+static inline bool IsUnitSeenOnTile(const CUnit &unit, int p, unsigned int index)
 {
-	Assert(unit.Type);
+	if (unit.Type->PermanentCloak && unit.Player != &Players[p]) {
+		return Map.VisCloak[p][index] != 0;
+	}
+	//  Icky ugly code trick. With NoFogOfWar we haveto be > 0;
+	return Map.Visible[p][index] > 1 - (Map.NoFogOfWar ? 1 : 0);
+}
+
+/**
+**  Count the tiles of a unit placed at pos, and not covered by the unit
+**  placed at other, on which a player sees the unit.
+**
+**  @param unit   Unit to check.
+**  @param p      Index of the player.
+**  @param pos    Position of the unit to count.
+**  @param other  Position of the unit whose tiles are not counted.
+*/
+static int CountSeenTiles(const CUnit &unit, int p, const Vec2i &pos, const Vec2i &other)
+{
+	const int width = unit.Type->TileWidth;
+	const int height = unit.Type->TileHeight;
+	int count = 0;
 
-	// FIXME: optimize, only work on certain players?
-	// This is for instance good for updating shared vision...
+	for (int y = 0; y < height; ++y) {
+		const bool otherRow = pos.y + y >= other.y && pos.y + y < other.y + height;
+		for (int x = 0; x < width; ++x) {
+			if (otherRow && pos.x + x >= other.x && pos.x + x < other.x + width) {
+				continue;
+			}
+			if (IsUnitSeenOnTile(unit, p, Map.getIndex(pos.x + x, pos.y + y))) {
+				++count;
+			}
+		}
+	}
+	return count;
+}
+
+/**
+**  Set the visibility counts of a unit, and make it go out of or under
+**  the fog of war for the players who start or stop seeing it.
+**
+**  @param unit      Unit to update.
+**  @param viscount  New VisCount of each player.
+*/
+static void SetUnitVisCount(CUnit &unit, const int *viscount)
+{
+	//  The players who see the unit only change when a count goes from or
+	//  to 0.
+	bool fogChanged = false;
+	for (int p = 0; p < PlayerMax; ++p) {
+		if (Players[p].Type != PlayerNobody && !unit.VisCount[p] != !viscount[p]) {
+			fogChanged = true;
+			break;
+		}
+	}
+	if (!fogChanged) {
+		for (int p = 0; p < PlayerMax; ++p) {
+			if (Players[p].Type != PlayerNobody) {
+				unit.VisCount[p] = viscount[p];
+			}
+		}
+		return;
+	}
 
 	//  Store old values in oldv[p]. This store if the player could see the
 	//  unit before this calc.
@@ -1602,35 +1760,9 @@ void UnitCountSeen(CUnit &unit)
 			oldv[p] = unit.IsVisible(Players[p]);
 		}
 	}
-
-	//  Calculate new VisCount values.
-	const int height = unit.Type->TileHeight;
-	const int width = unit.Type->TileWidth;
-
 	for (int p = 0; p < PlayerMax; ++p) {
 		if (Players[p].Type != PlayerNobody) {
-			int newv = 0;
-			int y = height;
-			unsigned int index = unit.Offset;
-			do {
-				CMapField *mf = Map.Field(index);
-				int x = width;
-				do {
-					if (unit.Type->PermanentCloak && unit.Player != &Players[p]) {
-						if (mf->VisCloak[p]) {
-							newv++;
-						}
-					} else {
-						//  Icky ugly code trick. With NoFogOfWar we haveto be > 0;
-						if (mf->Visible[p] > 1 - (Map.NoFogOfWar ? 1 : 0)) {
-							newv++;
-						}
-					}
-					++mf;
-				} while (--x);
-				index += Map.Info.MapWidth;
-			} while (--y);
-			unit.VisCount[p] = newv;
+			unit.VisCount[p] = viscount[p];
 		}
 	}
 
@@ -1656,6 +1788,72 @@ void UnitCountSeen(CUnit &unit)
 	}
 }
 
+/**
+**  Recalculates a units visiblity count. This happens when a unit is
+**  placed on the map, or when the fog of war is changed.
+**
+**  @param unit  pointer to the unit to check if seen
+*/
+void UnitCountSeen(CUnit &unit)
+{
+	Assert(unit.Type);
+
+	//  Calculate new VisCount values.
+	const int height = unit.Type->TileHeight;
+	const int width = unit.Type->TileWidth;
+	int viscount[PlayerMax];
+
+	for (int p = 0; p < PlayerMax; ++p) {
+		if (Players[p].Type != PlayerNobody) {
+			int newv = 0;
+			int y = height;
+			unsigned int index = unit.Offset;
+			do {
+				int x = width;
+				do {
+					if (IsUnitSeenOnTile(unit, p, index)) {
+						newv++;
+					}
+					++index;
+				} while (--x);
+				index += Map.Info.MapWidth - width;
+			} while (--y);
+			viscount[p] = newv;
+		}
+	}
+	SetUnitVisCount(unit, viscount);
+}
+
+/**
+**  Update the visibility count of a unit which has moved.
+**
+**  The tile marks keep the count of the tiles under the unit, so only
+**  the tiles left and the tiles entered are checked.
+**
+**  @param unit    Unit which has moved, with its sight not yet marked.
+**  @param oldPos  Position of the unit before the move.
+*/
+void UnitCountSeenMoved(CUnit &unit, const Vec2i &oldPos)
+{
+	Assert(unit.Type);
+
+	// The tile marks of cloak detection don't count the tiles seen by the
+	// owner of a permanently cloaked unit, count them again.
+	if (unit.Type->PermanentCloak) {
+		UnitCountSeen(unit);
+		return;
+	}
+	int viscount[PlayerMax];
+
+	for (int p = 0; p < PlayerMax; ++p) {
+		if (Players[p].Type != PlayerNobody) {
+			viscount[p] = unit.VisCount[p] + CountSeenTiles(unit, p, unit.tilePos, oldPos)
+						  - CountSeenTiles(unit, p, oldPos, unit.tilePos);
+		}
+	}
+	SetUnitVisCount(unit, viscount);
+}
+
 /**
 **  Returns true, if the unit is visible. It check the Viscount of
 **  the player and everyone who shares vision with him.
@@ -2283,8 +2481,11 @@ CUnit *UnitOnScreen(CUnit *ounit, int x, int y)
 	if (!ounit) { // no old on this position
 		flag = 1;
 	}
-	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
-		CUnit &unit = **it;
+	// Only the units near the position, in the order of UnitManager.
+	static std::vector<CUnit *> table;
+	FindUnitsNearMapPixel(PixelPos(x, y), table);
+	for (size_t i = 0; i != table.size(); ++i) {
+		CUnit &unit = *table[i];
 		if (!ReplayRevealMap && !unit.IsVisibleAsGoal(*ThisPlayer)) {
 			continue;
 		}
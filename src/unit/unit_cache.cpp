@@ -44,6 +44,115 @@
 #include "unittype.h"
 #include "map.h"
 
+#include <algorithm>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------
+-- Variables
+----------------------------------------------------------------------------*/
+
+/// Side of a cell of the unit grid, in tiles
+static const int UnitGridCellSize = 8;
+
+/// Units on the map, by cells of the map, for the screen picking
+static std::vector<std::vector<CUnit *> > UnitGrid;
+/// Number of cells in a row of the unit grid
+static int UnitGridColumns;
+/// Farthest, in pixels, a unit inserted in the grid can be selected from its tile
+static PixelDiff UnitGridReach;
+
+/*----------------------------------------------------------------------------
+-- Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Get the cell of the unit grid of a tile.
+*/
+static std::vector<CUnit *> &UnitGridCell(const Vec2i &pos)
+{
+	if (UnitGrid.empty()) {
+		UnitGridColumns = (Map.Info.MapWidth + UnitGridCellSize - 1) / UnitGridCellSize;
+		const int rows = (Map.Info.MapHeight + UnitGridCellSize - 1) / UnitGridCellSize;
+		UnitGrid.resize(UnitGridColumns * rows);
+		UnitGridReach.x = 0;
+		UnitGridReach.y = 0;
+	}
+	return UnitGrid[pos.x / UnitGridCellSize + (pos.y / UnitGridCellSize) * UnitGridColumns];
+}
+
+/**
+**  Insert a unit in the unit grid.
+*/
+static void UnitGridInsert(CUnit &unit)
+{
+	const CUnitType &type = *unit.Type;
+
+	UnitGridCell(unit.tilePos).push_back(&unit);
+
+	// A moving unit is at most one tile away from its tile.
+	const int reachx = PixelTileSize.x + abs(unit.IX) + (type.TileWidth * PixelTileSize.x + type.BoxWidth) / 2;
+	const int reachy = PixelTileSize.y + abs(unit.IY) + (type.TileHeight * PixelTileSize.y + type.BoxHeight) / 2;
+	UnitGridReach.x = std::max<int>(UnitGridReach.x, reachx);
+	UnitGridReach.y = std::max<int>(UnitGridReach.y, reachy);
+}
+
+/**
+**  Remove a unit from the unit grid.
+*/
+static void UnitGridRemove(CUnit &unit)
+{
+	std::vector<CUnit *> &cell = UnitGridCell(unit.tilePos);
+	std::vector<CUnit *>::iterator it = std::find(cell.begin(), cell.end(), &unit);
+
+	Assert(it != cell.end());
+	*it = cell.back();
+	cell.pop_back();
+}
+
+/**
+**  Compare units by their order in the unit manager.
+*/
+static bool UnitManagerOrder(const CUnit *lhs, const CUnit *rhs)
+{
+	return lhs->UnitManagerData.GetUnitIndex() < rhs->UnitManagerData.GetUnitIndex();
+}
+
+/**
+**  Find the units on the map whose selection box may contain a map pixel.
+**
+**  @param pos    Map pixel position.
+**  @param units  Units found, in the order of the unit manager.
+*/
+void FindUnitsNearMapPixel(const PixelPos &pos, std::vector<CUnit *> &units)
+{
+	units.clear();
+	if (UnitGrid.empty()) {
+		return;
+	}
+	const int minx = std::max(0, (pos.x - UnitGridReach.x) / PixelTileSize.x / UnitGridCellSize);
+	const int maxx = std::min(UnitGridColumns - 1, std::max(0, pos.x + UnitGridReach.x) / PixelTileSize.x / UnitGridCellSize);
+	const int rows = UnitGrid.size() / UnitGridColumns;
+	const int miny = std::max(0, (pos.y - UnitGridReach.y) / PixelTileSize.y / UnitGridCellSize);
+	const int maxy = std::min(rows - 1, std::max(0, pos.y + UnitGridReach.y) / PixelTileSize.y / UnitGridCellSize);
+
+	for (int y = miny; y <= maxy; ++y) {
+		for (int x = minx; x <= maxx; ++x) {
+			const std::vector<CUnit *> &cell = UnitGrid[x + y * UnitGridColumns];
+			units.insert(units.end(), cell.begin(), cell.end());
+		}
+	}
+	std::sort(units.begin(), units.end(), UnitManagerOrder);
+}
+
+/**
+**  Free the unit grid, with the map.
+*/
+void FreeUnitGrid()
+{
+	UnitGrid.clear();
+	UnitGridColumns = 0;
+}
+
 /**
 **  Insert new unit into cache.
 **
@@ -66,6 +175,7 @@ void CMap::Insert(CUnit &unit)
 		} while (--j && unit.tilePos.x + (j - w) < Info.MapWidth);
 		index += Info.MapWidth;
 	} while (--i && unit.tilePos.y + (i - h) < Info.MapHeight);
+	UnitGridInsert(unit);
 }
 
 /**
@@ -90,6 +200,7 @@ void CMap::Remove(CUnit &unit)
 		} while (--j && unit.tilePos.x + (j - w) < Info.MapWidth);
 		index += Info.MapWidth;
 	} while (--i && unit.tilePos.y + (i - h) < Info.MapHeight);
+	UnitGridRemove(unit);
 }
 
 
@@ -100,7 +100,7 @@ VisitResult UnitFinder::Visit(TerrainTraversal &terrainTraversal, const Vec2i &p
 		return VisitResult_Finished;
 	}
 	if (CanMoveToMask(pos, movemask)) { // reachable
-		if (terrainTraversal.Get(pos) <= maxDist) {
+		if (maxDist >= 0 && terrainTraversal.Get(pos) <= TerrainTraversal::dataType(maxDist)) {
 			return VisitResult_Ok;
 		} else {
 			return VisitResult_DeadEnd;
@@ -137,7 +137,7 @@ VisitResult TerrainFinder::Visit(TerrainTraversal &terrainTraversal, const Vec2i
 		return VisitResult_Finished;
 	}
 	if (CanMoveToMask(pos, movemask)) { // reachable
-		if (terrainTraversal.Get(pos) <= maxDist) {
+		if (maxDist >= 0 && terrainTraversal.Get(pos) <= TerrainTraversal::dataType(maxDist)) {
 			return VisitResult_Ok;
 		} else {
 			return VisitResult_DeadEnd;
@@ -398,7 +398,7 @@ VisitResult ResourceUnitFinder::Visit(TerrainTraversal &terrainTraversal, const
 		}
 	}
 	if (CanMoveToMask(pos, movemask)) { // reachable
-		if (terrainTraversal.Get(pos) < maxRange) {
+		if (maxRange > 0 && terrainTraversal.Get(pos) < TerrainTraversal::dataType(maxRange)) {
 			return VisitResult_Ok;
 		} else {
 			return VisitResult_DeadEnd;
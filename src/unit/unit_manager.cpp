@@ -40,6 +40,8 @@
 #include "iolib.h"
 #include "script.h"
 
+#include <new>
+
 
 /*----------------------------------------------------------------------------
 --  Variables
@@ -47,6 +49,9 @@
 
 CUnitManager UnitManager;          /// Unit manager
 
+/// Number of units allocated together, for the loops over all the units
+static const unsigned int UnitSlabSize = 256;
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -63,15 +68,46 @@ void CUnitManager::Init()
 	lastCreated = NULL;
 	//Assert(units.empty());
 	units.clear();
-	// Release memory of units in release list.
-	while (!releasedUnits.empty()) {
-		CUnit *unit = releasedUnits.front();
-		releasedUnits.pop_front();
-		delete unit;
+	releasedUnits.clear();
+
+	// Release memory of units and initialize the free unit slots
+	FreeSlotUnits();
+}
+
+/**
+**  Make the unit of a new slot.
+**
+**  The units of following slots are next to each other in memory.
+**
+**  @return  New unit
+*/
+CUnit *CUnitManager::NewSlotUnit()
+{
+	const unsigned int slot = unitSlots.size();
+
+	if (slot % UnitSlabSize == 0) {
+		slabs.push_back(static_cast<CUnit *>(::operator new(UnitSlabSize * sizeof(CUnit))));
 	}
+	CUnit *unit = new (slabs.back() + slot % UnitSlabSize) CUnit;
+
+	unit->UnitManagerData.slot = slot;
+	unitSlots.push_back(unit);
+	return unit;
+}
 
-	// Initialize the free unit slots
+/**
+**  Free the units of all the slots.
+*/
+void CUnitManager::FreeSlotUnits()
+{
+	for (std::vector<CUnit *>::iterator it = unitSlots.begin(); it != unitSlots.end(); ++it) {
+		(*it)->~CUnit();
+	}
 	unitSlots.clear();
+	for (std::vector<CUnit *>::iterator it = slabs.begin(); it != slabs.end(); ++it) {
+		::operator delete(*it);
+	}
+	slabs.clear();
 }
 
 /**
@@ -91,11 +127,7 @@ CUnit *CUnitManager::AllocUnit()
 		unit->UnitManagerData.unitSlot = -1;
 		return unit;
 	} else {
-		CUnit *unit = new CUnit;
-
-		unit->UnitManagerData.slot = unitSlots.size();
-		unitSlots.push_back(unit);
-		return unit;
+		return NewSlotUnit();
 	}
 }
 
@@ -187,9 +219,7 @@ void CUnitManager::Load(lua_State *l)
 	}
 	unsigned int unitCount = LuaToNumber(l, 1);
 	for (unsigned int i = 0; i < unitCount; i++) {
-		CUnit *unit = new CUnit;
-		unitSlots.push_back(unit);
-		unit->UnitManagerData.slot = i;
+		NewSlotUnit();
 	}
 	for (unsigned int i = 2; i <= args; i++) {
 		int unit_index = -1;
@@ -106,6 +106,15 @@ void PathFinderOutput::Save(CFile &file) const
 			file.printf("%d, ", this->Path[i]);
 		}
 		file.printf("},");
+		// Map changes the path hasn't been checked against yet.
+		const unsigned int mapChanges = GetPathfinderMapChanges() - this->MapChanges;
+		if (mapChanges) {
+			file.printf("\"map-changes\", %u, ", mapChanges);
+		}
+	}
+	if (this->Solved) {
+		// A reached or unreachable goal is only kept in Length.
+		file.printf("\"solved\", %d, ", std::min(this->Length, 0));
 	}
 	file.printf("\"cycles\", %d", this->Cycles);
 